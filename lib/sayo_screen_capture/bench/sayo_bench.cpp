@@ -0,0 +1,124 @@
+// Capture throughput against the simulated device: frames per second and the
+// frame time distribution (p50 / p99 / max) of CaptureScreenFrame.
+//
+//   sayo_bench [--frames N] [--report64] [--latency-us N] [--interval-us N]
+//              [--jitter-us N] [--drop P] [--realtime]
+//
+// Runs on a VirtualClock by default, so the numbers are the simulated link's and
+// repeat exactly; --realtime uses the steady clock and measures this machine too.
+// Exits non-zero when a frame fails outright.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "sayo_screen_capture.h"
+#include "sayo_sim_device.h"
+
+namespace {
+    struct BenchConfig {
+        uint32_t frames = 500;
+        bool report64 = false;
+        bool realtime = false;
+        uint32_t latencyUs = 1000;
+        uint32_t intervalUs = 125;
+        uint32_t jitterUs = 0;
+        double dropRate = 0.0;
+    };
+
+    bool parse_args(const int argc, char** argv, BenchConfig& config) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (std::strcmp(arg, "--report64") == 0) {
+                config.report64 = true;
+            } else if (std::strcmp(arg, "--realtime") == 0) {
+                config.realtime = true;
+            } else if (value && std::strcmp(arg, "--frames") == 0) {
+                config.frames = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+                i++;
+            } else if (value && std::strcmp(arg, "--latency-us") == 0) {
+                config.latencyUs = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+                i++;
+            } else if (value && std::strcmp(arg, "--interval-us") == 0) {
+                config.intervalUs = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+                i++;
+            } else if (value && std::strcmp(arg, "--jitter-us") == 0) {
+                config.jitterUs = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+                i++;
+            } else if (value && std::strcmp(arg, "--drop") == 0) {
+                config.dropRate = std::strtod(value, nullptr);
+                i++;
+            } else {
+                std::fprintf(stderr, "unknown or incomplete argument: %s\n", arg);
+                return false;
+            }
+        }
+        return config.frames > 0;
+    }
+
+    double percentile(std::vector<double> sorted, const double p) {
+        std::sort(sorted.begin(), sorted.end());
+        const size_t at = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[(std::min)(at, sorted.size() - 1)];
+    }
+}
+
+int main(const int argc, char** argv) {
+    BenchConfig config{};
+    if (!parse_args(argc, argv, config)) {
+        return 2;
+    }
+
+    sayo::VirtualClock clock;
+    sayo::SimulatedDeviceConfig deviceConfig{};
+    deviceConfig.responseLatencyUs = config.latencyUs;
+    deviceConfig.reportIntervalUs = config.intervalUs;
+    deviceConfig.jitterUs = config.jitterUs;
+    deviceConfig.dropRate = config.dropRate;
+    deviceConfig.clock = config.realtime ? nullptr : &clock;
+    sayo::ProtocolConstants proto{};
+    if (config.report64) {
+        deviceConfig.reportId = 0x21;
+        deviceConfig.reportLen = 64;
+        proto.reportId22 = 0x21;
+        proto.reportLen22 = 64;
+    }
+    sayo::SimulatedDevice device(deviceConfig);
+
+    std::vector<uint8_t> scratchIn(proto.reportLen22, 0);
+    std::vector<uint8_t> rgb565;
+    std::vector<double> frameUs;
+    frameUs.reserve(config.frames);
+    uint32_t incomplete = 0;
+    uint32_t failed = 0;
+    const size_t frameBytes = static_cast<size_t>(deviceConfig.lcdW) * deviceConfig.lcdH * 2;
+
+    const auto start = device.Now();
+    for (uint32_t i = 0; i < config.frames; i++) {
+        const auto t0 = device.Now();
+        sayo::CaptureStats stats{};
+        const sayo::CaptureFrameResult r = sayo::CaptureScreenFrame(
+            device, deviceConfig.lcdW, deviceConfig.lcdH, scratchIn, rgb565, &stats, proto);
+        frameUs.push_back(std::chrono::duration<double, std::micro>(device.Now() - t0).count());
+        if (r != sayo::CaptureFrameResult::Ok) {
+            failed++;
+        } else if (stats.bytesCovered < frameBytes) {
+            incomplete++;
+        }
+    }
+    const double totalSecs = std::chrono::duration<double>(device.Now() - start).count();
+
+    std::printf("%s clock, %ux%u, %zu-byte reports, latency %u us, interval %u us, jitter %u us, drop %.3f\n",
+                config.realtime ? "steady" : "virtual", deviceConfig.lcdW, deviceConfig.lcdH, deviceConfig.reportLen,
+                config.latencyUs, config.intervalUs, config.jitterUs, config.dropRate);
+    std::printf("frames %u  failed %u  incomplete %u\n", config.frames, failed, incomplete);
+    std::printf("fps %.1f  frame us: p50 %.0f  p99 %.0f  max %.0f\n",
+                totalSecs > 0.0 ? static_cast<double>(config.frames) / totalSecs : 0.0,
+                percentile(frameUs, 0.50), percentile(frameUs, 0.99), percentile(frameUs, 1.0));
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+// FrameExchange on its own, both sides flat out: a producer thread fills every
+// back buffer with one value and publishes, this thread acquires and checks each
+// frame it gets. Reports the longest single Publish() and Acquire().
+//
+//   sayo_exchange_stress [--ms N]
+//
+// Exits non-zero on a torn frame or a sequence going backwards. Built with
+// -DSAYO_SANITIZE_THREAD=ON it is the race check for the triple buffer.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "sayo_frame_exchange.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // every byte of frame n is this, so a frame mixing two is easy to spot
+    uint8_t frame_fill(const uint64_t n) {
+        return static_cast<uint8_t>(n * 37 + 1);
+    }
+
+    bool uniform(const std::vector<uint8_t>& pixels) {
+        return pixels.empty() ||
+            std::all_of(pixels.begin(), pixels.end(), [&](const uint8_t b) { return b == pixels[0]; });
+    }
+
+    double elapsed_us(const Clock::time_point since) {
+        return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+    }
+}
+
+int main(const int argc, char** argv) {
+    uint32_t durationMs = 1000;
+    if (argc == 3 && std::strcmp(argv[1], "--ms") == 0) {
+        durationMs = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+    } else if (argc != 1) {
+        std::fprintf(stderr, "usage: %s [--ms N]\n", argv[0]);
+        return 2;
+    }
+
+    sayo::FrameExchange frames(160, 80);
+    std::atomic<bool> stop{false};
+
+    double producerMaxUs = 0.0;
+    std::thread producer([&] {
+        for (uint64_t n = 0; !stop.load(std::memory_order_relaxed); n++) {
+            sayo::Frame& back = frames.Back();
+            std::memset(back.Pixels().data(), frame_fill(n), back.Pixels().size());
+            const auto t0 = Clock::now();
+            (void)frames.Publish();
+            producerMaxUs = (std::max)(producerMaxUs, elapsed_us(t0));
+        }
+    });
+
+    uint64_t acquired = 0;
+    uint64_t torn = 0;
+    uint64_t regressions = 0;
+    uint64_t lastSequence = 0;
+    double consumerMaxUs = 0.0;
+    const auto end = Clock::now() + std::chrono::milliseconds(durationMs);
+    while (Clock::now() < end) {
+        const auto t0 = Clock::now();
+        const bool fresh = frames.Acquire();
+        consumerMaxUs = (std::max)(consumerMaxUs, elapsed_us(t0));
+        if (!fresh) {
+            std::this_thread::yield();
+            continue;
+        }
+        acquired++;
+        const sayo::Frame& front = frames.Front();
+        if (front.Meta().sequence < lastSequence) {
+            regressions++;
+        }
+        lastSequence = front.Meta().sequence;
+        if (!uniform(front.Pixels())) {
+            torn++;
+        }
+    }
+    stop.store(true, std::memory_order_relaxed);
+    producer.join();
+
+    std::printf("published %llu  acquired %llu  torn %llu  regressions %llu\n",
+                static_cast<unsigned long long>(frames.PublishedSequence()),
+                static_cast<unsigned long long>(acquired), static_cast<unsigned long long>(torn),
+                static_cast<unsigned long long>(regressions));
+    std::printf("max us: publish %.1f  acquire %.1f\n", producerMaxUs, consumerMaxUs);
+    return torn == 0 && regressions == 0 && acquired > 0 ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// The UI side of a capture: a CaptureSession captures from a SimulatedDevice with
+// slow frames while this thread plays the window. Every tick it does what WM_TIMER
+// and WM_PAINT do (State(), the sequence check, Acquire() and Front()), now and then
+// Pause(), Resume() or Stats(), and times each tick. The session owns the device
+// and publishes through its FrameExchange, so a tick should never wait on a
+// capture: the tick times stay in microseconds while a frame takes tens of
+// milliseconds.
+//
+//   sayo_session_stress [--ms N]
+//
+// Exits non-zero on a torn frame or a sequence going backwards. Built with
+// -DSAYO_SANITIZE_THREAD=ON it is also the race check for the session.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "sayo_capture_session.h"
+#include "sayo_sim_device.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // SimulatedDevice timing for frames of about 90 ms
+    constexpr uint32_t kResponseLatencyUs = 40000;
+    constexpr uint32_t kReportIntervalUs = 2000;
+    constexpr auto kTickPeriod = std::chrono::milliseconds(1);
+    // every this many ticks the consumer pauses or resumes the session
+    constexpr uint64_t kPauseEveryTicks = 200;
+
+    // every byte of device frame n is this, so a frame mixing two is easy to spot
+    uint8_t frame_fill(const uint64_t frameIndex) {
+        return static_cast<uint8_t>(frameIndex * 37 + 1);
+    }
+
+    bool uniform(const std::vector<uint8_t>& pixels) {
+        return pixels.empty() ||
+            std::all_of(pixels.begin(), pixels.end(), [&](const uint8_t b) { return b == pixels[0]; });
+    }
+}
+
+int main(const int argc, char** argv) {
+    uint32_t durationMs = 2000;
+    if (argc == 3 && std::strcmp(argv[1], "--ms") == 0) {
+        durationMs = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+    } else if (argc != 1) {
+        std::fprintf(stderr, "usage: %s [--ms N]\n", argv[0]);
+        return 2;
+    }
+
+    sayo::SimulatedDeviceConfig deviceConfig{};
+    deviceConfig.responseLatencyUs = kResponseLatencyUs;
+    deviceConfig.reportIntervalUs = kReportIntervalUs;
+    auto device = std::make_unique<sayo::SimulatedDevice>(deviceConfig);
+    device->SetFrameGenerator([](const uint64_t frameIndex, std::vector<uint8_t>& rgb565) {
+        std::memset(rgb565.data(), frame_fill(frameIndex), rgb565.size());
+    });
+
+    sayo::SystemInfo info{};
+    info.lcdW = deviceConfig.lcdW;
+    info.lcdH = deviceConfig.lcdH;
+    sayo::OpenedDevice opened{};
+    opened.transport = std::move(device);
+    opened.path = "simulated";
+    opened.usagePage = 0xFF12;
+    opened.key = "simulated";
+
+    sayo::CaptureSession session(std::move(opened), info);
+    if (!session.Start()) {
+        std::fprintf(stderr, "session did not start\n");
+        return 1;
+    }
+    sayo::FrameExchange& frames = session.Frames();
+
+    std::vector<double> tickUs;
+    uint64_t ticks = 0;
+    uint64_t acquired = 0;
+    uint64_t torn = 0;
+    uint64_t regressions = 0;
+    uint64_t lastSequence = 0;
+    uint32_t frameMaxMs = 0;
+    bool paused = false;
+    const auto end = Clock::now() + std::chrono::milliseconds(durationMs);
+    while (Clock::now() < end) {
+        const auto t0 = Clock::now();
+        // WM_TIMER / WM_ERASEBKGND: is there a device, is anything new
+        const bool capturing = session.State() != sayo::SessionState::Stopped;
+        const bool fresh = frames.PublishedSequence() != frames.FrontSequence();
+        // WM_PAINT
+        const bool got = capturing && fresh && frames.Acquire();
+        if (ticks % kPauseEveryTicks == 0) {
+            // minimise/restore, and the once-a-second stats line
+            paused ? session.Resume() : session.Pause();
+            paused = !paused;
+            (void)session.Stats();
+        }
+        tickUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        ticks++;
+
+        if (got) {
+            const sayo::Frame& front = frames.Front();
+            acquired++;
+            if (front.Meta().sequence < lastSequence) {
+                regressions++;
+            }
+            lastSequence = front.Meta().sequence;
+            if (front.Complete() && !uniform(front.Pixels())) {
+                torn++;
+            }
+            frameMaxMs = (std::max)(frameMaxMs, front.Meta().stats.durationMs);
+        }
+        std::this_thread::sleep_until(t0 + kTickPeriod);
+    }
+    session.Stop();
+
+    std::sort(tickUs.begin(), tickUs.end());
+    double sum = 0.0;
+    for (const double us : tickUs) {
+        sum += us;
+    }
+    std::printf("ticks %llu  published %llu  acquired %llu  torn %llu  regressions %llu\n",
+                static_cast<unsigned long long>(ticks),
+                static_cast<unsigned long long>(frames.PublishedSequence()),
+                static_cast<unsigned long long>(acquired), static_cast<unsigned long long>(torn),
+                static_cast<unsigned long long>(regressions));
+    if (!tickUs.empty()) {
+        std::printf("tick us: mean %.1f  p99 %.1f  max %.1f  (longest frame %u ms)\n",
+                    sum / static_cast<double>(tickUs.size()), tickUs[(tickUs.size() - 1) * 99 / 100],
+                    tickUs.back(), frameMaxMs);
+    }
+    return torn == 0 && regressions == 0 && acquired > 0 ? 0 : 1;
+}
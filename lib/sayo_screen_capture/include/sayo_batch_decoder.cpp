@@ -0,0 +1,85 @@
+#include "sayo_batch_decoder.h"
+#include "sayo_checksum.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sayo {
+    BatchDecoder::BatchDecoder(const ProtocolConstants& proto)
+        : proto_(proto),
+          variant_(SelectReportVariant(proto)),
+          echo_(proto.echo) {
+    }
+
+    void BatchDecoder::Reset(const uint8_t echo) {
+        echo_ = echo;
+        sequence_ = {};
+        maxEnd_ = 0;
+    }
+
+    BatchDecodeStats BatchDecoder::Decode(const uint8_t* reports, const size_t stride, const size_t count,
+                                          const size_t* lens, const FrameTarget& target,
+                                          ReportDisposition* dispositions) {
+        BatchDecodeStats stats{};
+        // worked on in locals: the chunk copies could alias anything reached through this
+        detail::ChunkSequencer sequence = sequence_;
+        size_t maxEnd = maxEnd_;
+        uint16_t sums[kMaxGroup];
+        // checksums for a group at a time, small enough that the copies still find the
+        // reports in L1
+        const size_t groupSize = std::clamp<size_t>(kGroupBytes / (std::max)(stride, size_t{1}), 1, kMaxGroup);
+        for (size_t base = 0; base < count; base += groupSize) {
+            const size_t n = (std::min)(groupSize, count - base);
+            const uint8_t* group = reports + base * stride;
+            const size_t* groupLens = lens ? lens + base : nullptr;
+
+            // A device sends reports of one length; a group with a short read in it is
+            // rare enough to be summed a report at a time.
+            const size_t groupLen = groupLens ? (std::min)(groupLens[0], stride) : stride;
+            bool sameLen = true;
+            for (size_t i = 1; groupLens && i < n && sameLen; i++) {
+                sameLen = groupLens[i] == groupLen;
+            }
+            if (sameLen) {
+                detail::sum_words_le_batch(group, stride, groupLen, n, sums);
+            } else {
+                for (size_t i = 0; i < n; i++) {
+                    sums[i] = detail::sum_words_le(group + i * stride, (std::min)(groupLens[i], stride));
+                }
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                const size_t len = groupLens ? (std::min)(groupLens[i], stride) : stride;
+                detail::ScreenChunk chunk{};
+                ReportDisposition d = ReportDisposition::Applied;
+                if (!detail::decode_screen_chunk(variant_, group + i * stride, len, sums[i], proto_, chunk)) {
+                    d = ReportDisposition::Invalid;
+                } else if (!detail::echo_matches(chunk.echo, echo_, proto_)) {
+                    d = ReportDisposition::WrongEcho;
+                }
+                const size_t end = static_cast<size_t>(chunk.addr) + chunk.len;
+                if (d == ReportDisposition::Applied && end > target.bytes) {
+                    d = ReportDisposition::OutOfFrame;
+                }
+                if (d == ReportDisposition::Applied) {
+                    std::memcpy(target.rgb565 + chunk.addr, chunk.data, chunk.len);
+                    if (target.coverage) {
+                        target.coverage->Mark(chunk.addr, end);
+                    }
+                    maxEnd = (std::max)(maxEnd, end);
+                    stats.applied++;
+                    stats.bytesApplied += static_cast<uint32_t>(chunk.len);
+                    stats.gaps += sequence.Observe(chunk);
+                } else {
+                    stats.rejected++;
+                }
+                if (dispositions) {
+                    dispositions[base + i] = d;
+                }
+            }
+        }
+        sequence_ = sequence;
+        maxEnd_ = maxEnd;
+        return stats;
+    }
+}
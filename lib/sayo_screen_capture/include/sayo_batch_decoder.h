@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sayo_codec.h"
+#include "sayo_coverage.h"
+#include "sayo_protocol.h"
+#include "sayo_screen_capture.h"
+
+namespace sayo {
+    // What happened to one report of a batch.
+    enum class ReportDisposition : uint8_t {
+        // pixels copied into the frame
+        Applied,
+        // turned away by decode_screen_chunk: too short, another report id or command,
+        // bad crc, or a length field that points past the report or leaves no pixels
+        Invalid,
+        // answers some other request (see ProtocolConstants::tagRequests)
+        WrongEcho,
+        // reaches past the end of the frame
+        OutOfFrame,
+    };
+
+    // Where a batch's chunks go.
+    struct FrameTarget {
+        uint8_t* rgb565 = nullptr;
+        size_t bytes = 0;
+        // Optional; every applied chunk is marked.
+        CoverageMap* coverage = nullptr;
+    };
+
+    struct BatchDecodeStats {
+        uint32_t applied = 0;
+        uint32_t rejected = 0;
+        uint32_t bytesApplied = 0;
+        // chunks found missing between applied ones (index/address skips)
+        uint32_t gaps = 0;
+    };
+
+    // I/O-free decoder for CMD 0x25 reports: validates a whole span of received reports
+    // and copies the chunks of the valid ones into a frame, in one call. The checksums
+    // of same-length reports are computed a group at a time (two 64-byte reports per
+    // SIMD register), then each report goes through the same decode_screen_chunk as
+    // CaptureScreenFrame with its sum in hand. Feed it from anything that has reports
+    // in hand: PipelinedReader::DecodeQueued, a trace, a fuzzer.
+    //
+    // Chunk order is tracked across calls until the next Reset(), so gaps are counted
+    // the same way CaptureScreenFrame counts them.
+    class BatchDecoder {
+    public:
+        explicit BatchDecoder(const ProtocolConstants& proto = {});
+
+        // Starts a new frame, answering a request sent with `echo`.
+        void Reset(uint8_t echo);
+        void Reset() {
+            Reset(proto_.echo);
+        }
+
+        // count reports, stride bytes apart starting at reports. lens holds each report's
+        // length, or is nullptr when every report is stride bytes long. dispositions, if
+        // given, receives one entry per report.
+        BatchDecodeStats Decode(
+            const uint8_t* reports,
+            size_t stride,
+            size_t count,
+            const size_t* lens,
+            const FrameTarget& target,
+            ReportDisposition* dispositions = nullptr);
+
+        // One past the highest frame byte written since Reset().
+        size_t MaxEnd() const {
+            return maxEnd_;
+        }
+        bool Started() const {
+            return sequence_.started;
+        }
+
+    private:
+        static constexpr size_t kMaxGroup = 32;
+        static constexpr size_t kGroupBytes = 8 * 1024;
+
+        const ProtocolConstants proto_;
+        const ReportVariant variant_;
+        uint8_t echo_ = 0;
+        detail::ChunkSequencer sequence_{};
+        size_t maxEnd_ = 0;
+    };
+}
@@ -0,0 +1,188 @@
+#include "sayo_bringup.h"
+
+#include <chrono>
+#include <utility>
+
+namespace sayo {
+    namespace {
+        uint32_t elapsed_us(const SteadyClock::time_point since) {
+            return static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - since).count());
+        }
+    }
+
+    bool ConfigureForUsagePage(const unsigned short usagePage, ProtocolConstants& proto) {
+        // usage_page=0xFF12: report_id 0x22, 1024-byte reports (high-speed)
+        // usage_page=0xFF11: report_id 0x21, 64-byte reports (other polling rates)
+        if (usagePage == 0xFF11) {
+            proto.reportId22 = 0x21;
+            proto.reportLen22 = 64;
+            return true;
+        }
+        if (usagePage == 0xFF12) {
+            proto.reportId22 = 0x22;
+            proto.reportLen22 = 1024;
+            return true;
+        }
+        // 0xFF00 is the legacy interface; anything else keeps the defaults, like before
+        return usagePage != 0xFF00;
+    }
+
+    DeviceBringUp::DeviceBringUp(BringUpBackend& backend, const BringUpOptions& options, EventSink sink)
+        : backend_(backend),
+          options_(options),
+          sink_(std::move(sink)) {
+    }
+
+    DeviceBringUp::~DeviceBringUp() {
+        Cancel();
+        Wait();
+    }
+
+    void DeviceBringUp::Start() {
+        if (worker_.joinable()) {
+            return;
+        }
+        worker_ = std::thread([this] { (void)Run(); });
+    }
+
+    void DeviceBringUp::Cancel() {
+        cancel_.store(true, std::memory_order_release);
+    }
+
+    void DeviceBringUp::Wait() {
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    std::optional<BringUpResult> DeviceBringUp::TakeResult() {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        std::optional<BringUpResult> out = std::move(result_);
+        result_.reset();
+        return out;
+    }
+
+    void DeviceBringUp::enter(const BringUpStage stage, const BringUpError error) {
+        error_.store(error, std::memory_order_release);
+        stage_.store(stage, std::memory_order_release);
+        if (sink_) {
+            BringUpEvent event{};
+            event.stage = stage;
+            event.error = error;
+            event.elapsedUs = elapsed_us(start_);
+            sink_(event);
+        }
+    }
+
+    bool DeviceBringUp::cancelled() {
+        if (!cancel_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        enter(BringUpStage::Failed, BringUpError::Cancelled);
+        return true;
+    }
+
+    BringUpStage DeviceBringUp::Run() {
+        start_ = SteadyClock::now();
+        BringUpResult result{};
+        result.proto = options_.proto;
+
+        if (cancelled() || !open_device(result)) {
+            return Stage();
+        }
+        if (cancelled() || !query_info(result)) {
+            return Stage();
+        }
+        if (cacheDirty_) {
+            (void)options_.cache->Save();
+        }
+
+        result.timings.totalUs = elapsed_us(start_);
+        {
+            std::lock_guard<std::mutex> lock(resultMutex_);
+            result_ = std::move(result);
+        }
+        enter(BringUpStage::Ready);
+        return Stage();
+    }
+
+    bool DeviceBringUp::open_device(BringUpResult& result) {
+        std::optional<OpenedDevice> opened;
+
+        // Warm start: last run's collection, no enumeration.
+        const std::optional<OpenHint> hint = options_.cache ? options_.cache->LastOpen() : std::nullopt;
+        if (hint) {
+            enter(BringUpStage::Opening);
+            const auto t = SteadyClock::now();
+            opened = backend_.Open(*hint);
+            result.timings.openHintUs = elapsed_us(t);
+            result.openedFromHint = opened.has_value();
+        }
+
+        if (!opened) {
+            if (cancelled()) {
+                return false;
+            }
+            enter(BringUpStage::Enumerating);
+            auto t = SteadyClock::now();
+            const std::vector<OpenHint> candidates = backend_.Enumerate();
+            result.timings.enumerateUs = elapsed_us(t);
+
+            if (cancelled()) {
+                return false;
+            }
+            enter(BringUpStage::Opening);
+            t = SteadyClock::now();
+            for (const OpenHint& candidate : candidates) {
+                opened = backend_.Open(candidate);
+                if (opened) {
+                    break;
+                }
+            }
+            result.timings.openUs = elapsed_us(t);
+        }
+
+        if (!opened) {
+            enter(BringUpStage::Failed, BringUpError::NotFound);
+            return false;
+        }
+        if (!ConfigureForUsagePage(opened->usagePage, result.proto)) {
+            enter(BringUpStage::Failed, BringUpError::UnsupportedInterface);
+            return false;
+        }
+        if (options_.cache) {
+            cacheDirty_ |= options_.cache->SetLastOpen(OpenHint{opened->path, opened->usagePage});
+        }
+        result.device = std::move(*opened);
+        return true;
+    }
+
+    bool DeviceBringUp::query_info(BringUpResult& result) {
+        if (options_.cache) {
+            if (const std::optional<SystemInfo> cached = options_.cache->Find(result.device.key)) {
+                result.info = *cached;
+                result.infoFromCache = true;
+                return true;
+            }
+        }
+
+        enter(BringUpStage::QueryingInfo);
+        const auto t = SteadyClock::now();
+        const std::optional<SystemInfo> info = TryGetSystemInfo(*result.device.transport, result.proto);
+        result.timings.queryInfoUs = elapsed_us(t);
+        if (!info) {
+            enter(BringUpStage::Failed, BringUpError::InfoTimeout);
+            return false;
+        }
+        if (info->lcdW == 0 || info->lcdH == 0) {
+            enter(BringUpStage::Failed, BringUpError::InvalidInfo);
+            return false;
+        }
+        if (options_.cache) {
+            cacheDirty_ |= options_.cache->Store(result.device.key, *info);
+        }
+        result.info = *info;
+        return true;
+    }
+}
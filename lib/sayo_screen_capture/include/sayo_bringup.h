@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sayo_info_cache.h"
+#include "sayo_screen_capture.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    enum class BringUpStage : uint8_t {
+        Idle,
+        Enumerating,
+        Opening,
+        QueryingInfo,
+        // done: TakeResult() and start streaming
+        Ready,
+        Failed,
+    };
+
+    enum class BringUpError : uint8_t {
+        None,
+        NotFound,
+        // only the legacy usage_page=0xFF00 collection was found
+        UnsupportedInterface,
+        InfoTimeout,
+        InvalidInfo,
+        Cancelled,
+    };
+
+    // A vendor collection opened by a BringUpBackend.
+    struct OpenedDevice {
+        std::unique_ptr<Transport> transport;
+        std::string path;
+        unsigned short usagePage = 0;
+        // Identifies the device across runs (serial number when it has one); the
+        // DeviceInfoCache key.
+        std::string key;
+    };
+
+    // The platform side of bring-up. HidapiBringUpBackend is the real one; tests plug
+    // in one that hands out simulated devices.
+    class BringUpBackend {
+    public:
+        virtual ~BringUpBackend() = default;
+
+        // Vendor collections worth trying, best first.
+        virtual std::vector<OpenHint> Enumerate() = 0;
+        // Opens a collection and checks it still is what the hint says; nullopt otherwise.
+        // Called with the cached OpenHint before any enumeration, so keep it cheap.
+        virtual std::optional<OpenedDevice> Open(const OpenHint& where) = 0;
+    };
+
+    // Microseconds spent in each step; 0 for steps that were skipped.
+    struct BringUpTimings {
+        uint32_t openHintUs = 0;
+        uint32_t enumerateUs = 0;
+        uint32_t openUs = 0;
+        uint32_t queryInfoUs = 0;
+        uint32_t totalUs = 0;
+    };
+
+    struct BringUpEvent {
+        BringUpStage stage = BringUpStage::Idle;
+        BringUpError error = BringUpError::None;
+        // since Start()
+        uint32_t elapsedUs = 0;
+    };
+
+    struct BringUpResult {
+        OpenedDevice device;
+        // report id / length picked for the opened collection's usage page
+        ProtocolConstants proto{};
+        SystemInfo info{};
+        // info came from the cache; revalidate it once streaming
+        bool infoFromCache = false;
+        bool openedFromHint = false;
+        BringUpTimings timings{};
+    };
+
+    struct BringUpOptions {
+        ProtocolConstants proto{};
+        // Optional. Supplies and remembers the open hint and SystemInfo; saved on success.
+        DeviceInfoCache* cache = nullptr;
+    };
+
+    // Picks report id / length for a HID v2 vendor collection. False for collections
+    // sayomirror can't stream from (the legacy usage_page=0xFF00 one).
+    bool ConfigureForUsagePage(unsigned short usagePage, ProtocolConstants& proto);
+
+    // Device bring-up as a state machine on its own thread:
+    // open the cached path (or enumerate, then open) -> query SystemInfo (or take it
+    // from the cache) -> Ready. Every stage change goes to the event sink, which runs
+    // on the bring-up thread, so a UI only has to forward it to its own thread.
+    // No platform calls of its own; everything device-specific goes through the backend.
+    class DeviceBringUp {
+    public:
+        using EventSink = std::function<void(const BringUpEvent&)>;
+
+        DeviceBringUp(BringUpBackend& backend, const BringUpOptions& options, EventSink sink = {});
+        DeviceBringUp(const DeviceBringUp&) = delete;
+        DeviceBringUp& operator=(const DeviceBringUp&) = delete;
+        // Cancels and joins.
+        ~DeviceBringUp();
+
+        void Start();
+        // Runs every step on the calling thread; returns the final stage.
+        BringUpStage Run();
+        // Stops before the next step. A step already blocked in the device runs to its end.
+        void Cancel();
+        void Wait();
+
+        BringUpStage Stage() const {
+            return stage_.load(std::memory_order_acquire);
+        }
+        BringUpError Error() const {
+            return error_.load(std::memory_order_acquire);
+        }
+        // The opened device once Ready; hands it over once.
+        std::optional<BringUpResult> TakeResult();
+
+    private:
+        void enter(BringUpStage stage, BringUpError error = BringUpError::None);
+        bool cancelled();
+        bool open_device(BringUpResult& result);
+        bool query_info(BringUpResult& result);
+
+        BringUpBackend& backend_;
+        BringUpOptions options_;
+        EventSink sink_;
+        SteadyClock::time_point start_{};
+
+        std::atomic<BringUpStage> stage_{BringUpStage::Idle};
+        std::atomic<BringUpError> error_{BringUpError::None};
+        std::atomic<bool> cancel_{false};
+        bool cacheDirty_ = false;
+
+        std::mutex resultMutex_;
+        std::optional<BringUpResult> result_;
+
+        std::thread worker_;
+    };
+}
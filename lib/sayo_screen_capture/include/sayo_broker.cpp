@@ -0,0 +1,708 @@
+#include "sayo_broker.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace sayo {
+    namespace {
+        constexpr uint32_t kMagic = 0x4f594153; // "SAYO"
+        constexpr uint32_t kVersion = 1;
+        constexpr int kListenBacklog = 16;
+        constexpr int kRequestTimeoutMs = 1000;
+        // how often a waiting client checks the socket for a broker that went away
+        constexpr int kClientPollMs = 250;
+
+        // Start of the memfd. Written only by the broker; clients map it read-only.
+        struct alignas(64) ShmHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t slotCount;
+            uint32_t slotStride;
+            uint32_t frameBytes;
+            uint16_t width;
+            uint16_t height;
+            // newest complete frame, 0 before the first
+            std::atomic<uint64_t> latest;
+            // futex word: bumped on every publish and state change
+            std::atomic<uint32_t> generation;
+            std::atomic<uint32_t> deviceLost;
+        };
+
+        // Followed by frameBytes of RGB565. sequence is 0 while the slot is rewritten,
+        // so a reader that sees the same non-zero value before and after its copy got
+        // a consistent frame.
+        struct alignas(64) SlotHeader {
+            std::atomic<uint64_t> sequence;
+            uint64_t publishedNs;
+            uint32_t bytesCovered;
+        };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring is shared between processes");
+        static_assert(std::atomic<uint32_t>::is_always_lock_free, "the ring is shared between processes");
+
+        enum class MessageType : uint32_t {
+            Hello = 1,
+            SystemInfo = 2,
+            Stats = 3,
+        };
+
+        // Every message is one SOCK_SEQPACKET datagram starting with this.
+        struct MessageHeader {
+            uint32_t magic;
+            MessageType type;
+        };
+
+        struct HelloReply {
+            MessageHeader h;
+            uint32_t version;
+            uint32_t pad;
+            uint64_t shmBytes;
+            // the memfd travels alongside as SCM_RIGHTS
+        };
+
+        struct SystemInfoReply {
+            MessageHeader h;
+            uint16_t lcdW;
+            uint16_t lcdH;
+            // -1 when the device didn't report one
+            int16_t refreshRate;
+            uint16_t pad;
+        };
+
+        struct StatsReply {
+            MessageHeader h;
+            uint64_t frames;
+            uint64_t framesIncomplete;
+            uint64_t deviceDrops;
+            uint64_t clientsAccepted;
+            uint64_t requests;
+            uint32_t clientsConnected;
+            uint32_t pad;
+            double fps;
+        };
+
+        size_t slot_stride(const size_t frameBytes) {
+            const size_t bytes = sizeof(SlotHeader) + frameBytes;
+            return (bytes + 63) & ~size_t{63};
+        }
+
+        SlotHeader* slot_at(uint8_t* shm, const ShmHeader& h, const uint64_t sequence) {
+            return reinterpret_cast<SlotHeader*>(shm + sizeof(ShmHeader) +
+                                                 static_cast<size_t>(sequence % h.slotCount) * h.slotStride);
+        }
+
+        const SlotHeader* slot_at(const uint8_t* shm, const ShmHeader& h, const uint64_t sequence) {
+            return slot_at(const_cast<uint8_t*>(shm), h, sequence);
+        }
+
+        uint32_t* futex_word(const ShmHeader& h) {
+            return reinterpret_cast<uint32_t*>(const_cast<std::atomic<uint32_t>*>(&h.generation));
+        }
+
+        void futex_wake_all(const ShmHeader& h) {
+            syscall(SYS_futex, futex_word(h), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+        }
+
+        void futex_wait(const ShmHeader& h, const uint32_t seen, const int timeoutMs) {
+            timespec ts{};
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+            syscall(SYS_futex, futex_word(h), FUTEX_WAIT, seen, &ts, nullptr, 0);
+        }
+
+        uint64_t now_ns() {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now().time_since_epoch()).count());
+        }
+
+        bool fill_address(const std::string& path, sockaddr_un& addr) {
+            addr = {};
+            addr.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+                errno = ENAMETOOLONG;
+                return false;
+            }
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            return true;
+        }
+
+        // flags are added to MSG_NOSIGNAL; the broker passes MSG_DONTWAIT
+        bool send_message(const int fd, const void* msg, const size_t len, const int passFd = -1,
+                          const int flags = 0) {
+            iovec iov{};
+            iov.iov_base = const_cast<void*>(msg);
+            iov.iov_len = len;
+            msghdr mh{};
+            mh.msg_iov = &iov;
+            mh.msg_iovlen = 1;
+
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+            if (passFd >= 0) {
+                mh.msg_control = control;
+                mh.msg_controllen = sizeof(control);
+                cmsghdr* cm = CMSG_FIRSTHDR(&mh);
+                cm->cmsg_level = SOL_SOCKET;
+                cm->cmsg_type = SCM_RIGHTS;
+                cm->cmsg_len = CMSG_LEN(sizeof(int));
+                std::memcpy(CMSG_DATA(cm), &passFd, sizeof(int));
+            }
+            ssize_t r;
+            do {
+                r = sendmsg(fd, &mh, MSG_NOSIGNAL | flags);
+            } while (r < 0 && errno == EINTR);
+            return r == static_cast<ssize_t>(len);
+        }
+
+        // Blocking request/reply on the client socket. receivedFd gets a passed descriptor, if any.
+        bool round_trip(const int sock, const MessageType type, void* reply, const size_t replyLen,
+                        int* receivedFd = nullptr) {
+            const MessageHeader request{kMagic, type};
+            if (!send_message(sock, &request, sizeof(request))) {
+                return false;
+            }
+            pollfd pfd{sock, POLLIN, 0};
+            if (poll(&pfd, 1, kRequestTimeoutMs) <= 0) {
+                return false;
+            }
+
+            iovec iov{};
+            iov.iov_base = reply;
+            iov.iov_len = replyLen;
+            msghdr mh{};
+            mh.msg_iov = &iov;
+            mh.msg_iovlen = 1;
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+            mh.msg_control = control;
+            mh.msg_controllen = sizeof(control);
+
+            ssize_t r;
+            do {
+                r = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+            } while (r < 0 && errno == EINTR);
+            if (r != static_cast<ssize_t>(replyLen)) {
+                return false;
+            }
+            for (cmsghdr* cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+                if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+                    int fd = -1;
+                    std::memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+                    if (receivedFd) {
+                        *receivedFd = fd;
+                    } else {
+                        close(fd);
+                    }
+                }
+            }
+            MessageHeader h{};
+            std::memcpy(&h, reply, sizeof(h));
+            return h.magic == kMagic && h.type == type;
+        }
+    }
+
+    FrameBroker::FrameBroker(OpenedDevice device, const SystemInfo& info, const ProtocolConstants& proto,
+                             const BrokerOptions& options)
+        : device_(std::move(device)),
+          info_(info),
+          proto_(proto),
+          options_(options),
+          frameBytes_(static_cast<size_t>(info.lcdW) * info.lcdH * 2) {
+    }
+
+    FrameBroker::~FrameBroker() {
+        Stop();
+        if (listenFd_ >= 0) {
+            close(listenFd_);
+            unlink(options_.socketPath.c_str());
+        }
+        if (wakeFd_ >= 0) {
+            close(wakeFd_);
+        }
+        if (shm_) {
+            munmap(shm_, shmBytes_);
+        }
+        if (shmFd_ >= 0) {
+            close(shmFd_);
+        }
+        if (clientShmFd_ >= 0) {
+            close(clientShmFd_);
+        }
+    }
+
+    bool FrameBroker::Listen() {
+        if (listenFd_ >= 0) {
+            return true;
+        }
+        if (frameBytes_ == 0) {
+            errno = EINVAL;
+            return false;
+        }
+
+        const uint32_t slots = (std::max)(options_.slots, 2u);
+        const size_t stride = slot_stride(frameBytes_);
+        shmBytes_ = sizeof(ShmHeader) + static_cast<size_t>(slots) * stride;
+        shmFd_ = memfd_create("sayo-frames", MFD_CLOEXEC);
+        if (shmFd_ < 0 || ftruncate(shmFd_, static_cast<off_t>(shmBytes_)) != 0) {
+            return false;
+        }
+        void* p = mmap(nullptr, shmBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd_, 0);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+        shm_ = static_cast<uint8_t*>(p);
+        // Clients get a read-only descriptor of the same memfd: one that can't be
+        // mapped writable or ftruncate()d, so a client can't scribble on the slots.
+        const std::string self = "/proc/self/fd/" + std::to_string(shmFd_);
+        clientShmFd_ = open(self.c_str(), O_RDONLY | O_CLOEXEC);
+        if (clientShmFd_ < 0) {
+            return false;
+        }
+
+        // fresh memfd pages are zero, which is every atomic's initial state
+        auto* h = reinterpret_cast<ShmHeader*>(shm_);
+        h->magic = kMagic;
+        h->version = kVersion;
+        h->slotCount = slots;
+        h->slotStride = static_cast<uint32_t>(stride);
+        h->frameBytes = static_cast<uint32_t>(frameBytes_);
+        h->width = info_.lcdW;
+        h->height = info_.lcdH;
+
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeFd_ < 0) {
+            return false;
+        }
+
+        sockaddr_un addr{};
+        if (!fill_address(options_.socketPath, addr)) {
+            return false;
+        }
+        // non-blocking so serve_main can accept until the queue is empty
+        const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            return false;
+        }
+        // a previous broker that crashed leaves its socket file behind
+        unlink(options_.socketPath.c_str());
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, kListenBacklog) != 0) {
+            const int err = errno;
+            close(fd);
+            errno = err;
+            return false;
+        }
+        listenFd_ = fd;
+        return true;
+    }
+
+    void FrameBroker::Start() {
+        if (listenFd_ < 0 || captureThread_.joinable()) {
+            return;
+        }
+        stop_.store(false, std::memory_order_relaxed);
+        if (options_.reconnector) {
+            options_.reconnector->Reset();
+        }
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            startedAt_ = SteadyClock::now();
+        }
+        captureThread_ = std::thread([this] { capture_main(); });
+        serveThread_ = std::thread([this] { serve_main(); });
+    }
+
+    void FrameBroker::Stop() {
+        stop_.store(true, std::memory_order_relaxed);
+        if (options_.reconnector) {
+            options_.reconnector->Cancel();
+        }
+        if (wakeFd_ >= 0) {
+            const uint64_t one = 1;
+            (void)write(wakeFd_, &one, sizeof(one));
+        }
+        if (captureThread_.joinable()) {
+            captureThread_.join();
+        }
+        if (serveThread_.joinable()) {
+            serveThread_.join();
+        }
+        if (wakeFd_ >= 0) {
+            uint64_t drained = 0;
+            (void)read(wakeFd_, &drained, sizeof(drained));
+        }
+    }
+
+    void FrameBroker::capture_main() {
+        FrameStreamOptions streamOptions = options_.stream;
+        streamOptions.timing = &timing_;
+        if (!stream_) {
+            stream_ = std::make_unique<FrameStream>(*device_.transport, info_.lcdW, info_.lcdH, proto_, streamOptions);
+        }
+
+        while (!stop_.load(std::memory_order_relaxed)) {
+            CaptureStats stats{};
+            const CaptureFrameResult r = stream_->Next(frame_, &stats);
+            if (r == CaptureFrameResult::Ok) {
+                publish(frame_, stats);
+                if (options_.reconnector) {
+                    (void)options_.reconnector->NoteFrame();
+                }
+                continue;
+            }
+            if (r != CaptureFrameResult::DeviceError) {
+                continue;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(statsMutex_);
+                stats_.deviceDrops++;
+            }
+            set_device_lost(true);
+            if (!reopen()) {
+                return;
+            }
+            stream_ = std::make_unique<FrameStream>(*device_.transport, info_.lcdW, info_.lcdH, proto_, streamOptions);
+            set_device_lost(false);
+        }
+    }
+
+    bool FrameBroker::reopen() {
+        if (!options_.reconnector) {
+            return false;
+        }
+        // the stream holds a reference to the old transport
+        stream_.reset();
+        std::optional<OpenedDevice> reopened =
+            options_.reconnector->Reopen(OpenHint{device_.path, device_.usagePage});
+        if (!reopened) {
+            return false;
+        }
+        ProtocolConstants proto = proto_;
+        if (!ConfigureForUsagePage(reopened->usagePage, proto)) {
+            return false;
+        }
+        device_ = std::move(*reopened);
+        proto_ = proto;
+        return true;
+    }
+
+    void FrameBroker::publish(const std::vector<uint8_t>& rgb565, const CaptureStats& stats) {
+        auto* h = reinterpret_cast<ShmHeader*>(shm_);
+        const uint64_t seq = ++sequence_;
+        SlotHeader* slot = slot_at(shm_, *h, seq);
+
+        slot->sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(SlotHeader), rgb565.data(),
+                    (std::min)(rgb565.size(), frameBytes_));
+        slot->publishedNs = now_ns();
+        slot->bytesCovered = stats.bytesCovered;
+        slot->sequence.store(seq, std::memory_order_release);
+
+        h->latest.store(seq, std::memory_order_release);
+        h->generation.fetch_add(1, std::memory_order_release);
+        futex_wake_all(*h);
+
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.frames++;
+        if (stats.bytesCovered < frameBytes_) {
+            stats_.framesIncomplete++;
+        }
+    }
+
+    void FrameBroker::set_device_lost(const bool lost) {
+        auto* h = reinterpret_cast<ShmHeader*>(shm_);
+        h->deviceLost.store(lost ? 1 : 0, std::memory_order_release);
+        h->generation.fetch_add(1, std::memory_order_release);
+        futex_wake_all(*h);
+    }
+
+    void FrameBroker::serve_main() {
+        std::vector<int> clients;
+        std::vector<pollfd> fds;
+        while (!stop_.load(std::memory_order_relaxed)) {
+            fds.clear();
+            fds.push_back(pollfd{wakeFd_, POLLIN, 0});
+            fds.push_back(pollfd{listenFd_, POLLIN, 0});
+            for (const int fd : clients) {
+                fds.push_back(pollfd{fd, POLLIN, 0});
+            }
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (fds[0].revents) {
+                break;
+            }
+
+            std::vector<int> keep;
+            keep.reserve(clients.size() + 1);
+            for (size_t i = 2; i < fds.size(); i++) {
+                if (fds[i].revents == 0 || serve_request(fds[i].fd)) {
+                    keep.push_back(fds[i].fd);
+                } else {
+                    close(fds[i].fd);
+                }
+            }
+
+            if (fds[1].revents & POLLIN) {
+                // one wake for however many connections are queued: take them all
+                for (;;) {
+                    const int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+                    if (fd < 0) {
+                        if (errno == EINTR || errno == ECONNABORTED) {
+                            continue;
+                        }
+                        // EAGAIN once the queue is empty
+                        break;
+                    }
+                    keep.push_back(fd);
+                    std::lock_guard<std::mutex> lock(statsMutex_);
+                    stats_.clientsAccepted++;
+                }
+            }
+            clients.swap(keep);
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.clientsConnected = static_cast<uint32_t>(clients.size());
+        }
+
+        for (const int fd : clients) {
+            close(fd);
+        }
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.clientsConnected = 0;
+    }
+
+    bool FrameBroker::serve_request(const int fd) {
+        MessageHeader request{};
+        const ssize_t r = recv(fd, &request, sizeof(request), MSG_DONTWAIT);
+        if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return true;
+        }
+        if (r != static_cast<ssize_t>(sizeof(request)) || request.magic != kMagic) {
+            // hangup (0), error, or something that doesn't speak the protocol
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.requests++;
+        }
+
+        switch (request.type) {
+        case MessageType::Hello: {
+            HelloReply reply{};
+            reply.h = request;
+            reply.version = kVersion;
+            reply.shmBytes = shmBytes_;
+            return send_message(fd, &reply, sizeof(reply), clientShmFd_, MSG_DONTWAIT);
+        }
+        case MessageType::SystemInfo: {
+            SystemInfoReply reply{};
+            reply.h = request;
+            reply.lcdW = info_.lcdW;
+            reply.lcdH = info_.lcdH;
+            reply.refreshRate = info_.refreshRate ? static_cast<int16_t>(*info_.refreshRate) : int16_t{-1};
+            return send_message(fd, &reply, sizeof(reply), -1, MSG_DONTWAIT);
+        }
+        case MessageType::Stats: {
+            const BrokerStats s = Stats();
+            StatsReply reply{};
+            reply.h = request;
+            reply.frames = s.frames;
+            reply.framesIncomplete = s.framesIncomplete;
+            reply.deviceDrops = s.deviceDrops;
+            reply.clientsAccepted = s.clientsAccepted;
+            reply.requests = s.requests;
+            reply.clientsConnected = s.clientsConnected;
+            reply.fps = s.fps;
+            return send_message(fd, &reply, sizeof(reply), -1, MSG_DONTWAIT);
+        }
+        }
+        return false;
+    }
+
+    BrokerStats FrameBroker::Stats() const {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        BrokerStats s = stats_;
+        const double secs = std::chrono::duration<double>(SteadyClock::now() - startedAt_).count();
+        s.fps = secs > 0.0 ? static_cast<double>(s.frames) / secs : 0.0;
+        return s;
+    }
+
+    BrokerClient::~BrokerClient() {
+        Close();
+    }
+
+    bool BrokerClient::Connect(const std::string& socketPath) {
+        Close();
+        sockaddr_un addr{};
+        if (!fill_address(socketPath, addr)) {
+            return false;
+        }
+        sock_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (sock_ < 0) {
+            return false;
+        }
+        if (connect(sock_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+            Close();
+            return false;
+        }
+
+        HelloReply hello{};
+        int shmFd = -1;
+        if (!round_trip(sock_, MessageType::Hello, &hello, sizeof(hello), &shmFd) || shmFd < 0 ||
+            hello.version != kVersion || hello.shmBytes < sizeof(ShmHeader)) {
+            if (shmFd >= 0) {
+                close(shmFd);
+            }
+            Close();
+            return false;
+        }
+        void* p = mmap(nullptr, hello.shmBytes, PROT_READ, MAP_SHARED, shmFd, 0);
+        close(shmFd);
+        if (p == MAP_FAILED) {
+            Close();
+            return false;
+        }
+        shm_ = static_cast<const uint8_t*>(p);
+        shmBytes_ = hello.shmBytes;
+
+        const auto* h = reinterpret_cast<const ShmHeader*>(shm_);
+        if (h->magic != kMagic ||
+            sizeof(ShmHeader) + static_cast<size_t>(h->slotCount) * h->slotStride > shmBytes_) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void BrokerClient::Close() {
+        if (shm_) {
+            munmap(const_cast<uint8_t*>(shm_), shmBytes_);
+            shm_ = nullptr;
+            shmBytes_ = 0;
+        }
+        if (sock_ >= 0) {
+            close(sock_);
+            sock_ = -1;
+        }
+    }
+
+    std::optional<SystemInfo> BrokerClient::GetSystemInfo() {
+        SystemInfoReply reply{};
+        if (sock_ < 0 || !round_trip(sock_, MessageType::SystemInfo, &reply, sizeof(reply))) {
+            return std::nullopt;
+        }
+        SystemInfo info{};
+        info.lcdW = reply.lcdW;
+        info.lcdH = reply.lcdH;
+        if (reply.refreshRate >= 0) {
+            info.refreshRate = static_cast<uint8_t>(reply.refreshRate);
+        }
+        return info;
+    }
+
+    std::optional<BrokerStats> BrokerClient::GetStats() {
+        StatsReply reply{};
+        if (sock_ < 0 || !round_trip(sock_, MessageType::Stats, &reply, sizeof(reply))) {
+            return std::nullopt;
+        }
+        BrokerStats s{};
+        s.frames = reply.frames;
+        s.framesIncomplete = reply.framesIncomplete;
+        s.deviceDrops = reply.deviceDrops;
+        s.clientsAccepted = reply.clientsAccepted;
+        s.clientsConnected = reply.clientsConnected;
+        s.requests = reply.requests;
+        s.fps = reply.fps;
+        return s;
+    }
+
+    bool BrokerClient::copy_latest(std::vector<uint8_t>& outRgb565, BrokerFrameInfo* info) const {
+        const auto* h = reinterpret_cast<const ShmHeader*>(shm_);
+        // only fails while the broker laps this reader, so a few tries are plenty
+        for (int attempt = 0; attempt < 4; attempt++) {
+            const uint64_t seq = h->latest.load(std::memory_order_acquire);
+            if (seq == 0) {
+                return false;
+            }
+            const SlotHeader* slot = slot_at(shm_, *h, seq);
+            if (slot->sequence.load(std::memory_order_acquire) != seq) {
+                continue;
+            }
+            outRgb565.resize(h->frameBytes);
+            std::memcpy(outRgb565.data(), reinterpret_cast<const uint8_t*>(slot) + sizeof(SlotHeader), h->frameBytes);
+            const uint64_t publishedNs = slot->publishedNs;
+            const uint32_t bytesCovered = slot->bytesCovered;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->sequence.load(std::memory_order_relaxed) != seq) {
+                continue;
+            }
+            if (info) {
+                info->sequence = seq;
+                info->width = h->width;
+                info->height = h->height;
+                info->bytesCovered = bytesCovered;
+                info->publishedNs = publishedNs;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool BrokerClient::Snapshot(std::vector<uint8_t>& outRgb565, BrokerFrameInfo* info) const {
+        return shm_ && copy_latest(outRgb565, info);
+    }
+
+    bool BrokerClient::WaitFrame(const uint64_t afterSequence, std::vector<uint8_t>& outRgb565, BrokerFrameInfo* info,
+                                 const int timeoutMs) const {
+        if (!shm_) {
+            return false;
+        }
+        const auto* h = reinterpret_cast<const ShmHeader*>(shm_);
+        const auto deadline = SteadyClock::now() + std::chrono::milliseconds(timeoutMs);
+        for (;;) {
+            const uint32_t seen = h->generation.load(std::memory_order_acquire);
+            if (h->latest.load(std::memory_order_acquire) > afterSequence && copy_latest(outRgb565, info)) {
+                return true;
+            }
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - SteadyClock::now());
+            if (left.count() <= 0 || broker_gone()) {
+                return false;
+            }
+            futex_wait(*h, seen, static_cast<int>((std::min<int64_t>)(left.count(), kClientPollMs)));
+        }
+    }
+
+    bool BrokerClient::DeviceLost() const {
+        if (!shm_) {
+            return true;
+        }
+        return reinterpret_cast<const ShmHeader*>(shm_)->deviceLost.load(std::memory_order_acquire) != 0;
+    }
+
+    bool BrokerClient::broker_gone() const {
+        pollfd pfd{sock_, 0, 0};
+        return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR)) != 0;
+    }
+}
+
+#endif
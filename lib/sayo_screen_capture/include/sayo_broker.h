@@ -0,0 +1,165 @@
+#pragma once
+
+// Local frame broker for Linux capture hosts. One process owns the vendor
+// collection and runs the only capture loop; any number of local processes attach
+// over a Unix domain socket and read frames straight out of a shared memory ring
+// that the broker writes once per frame, however many clients there are.
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sayo_bringup.h"
+#include "sayo_frame_stream.h"
+#include "sayo_reconnect.h"
+#include "sayo_screen_capture.h"
+#include "sayo_timing.h"
+
+namespace sayo {
+    struct BrokerOptions {
+        std::string socketPath;
+        // Frames kept in shared memory. A client only loses a frame it is still copying
+        // when the broker publishes this many newer ones meanwhile.
+        uint32_t slots = 4;
+        FrameStreamOptions stream{};
+        // Optional. Gets the device back after a DeviceError; without one the broker
+        // stops capturing (clients see DeviceLost()) but keeps serving.
+        Reconnector* reconnector = nullptr;
+    };
+
+    struct BrokerStats {
+        uint64_t frames = 0;
+        uint64_t framesIncomplete = 0;
+        uint64_t deviceDrops = 0;
+        uint64_t clientsAccepted = 0;
+        uint32_t clientsConnected = 0;
+        uint64_t requests = 0;
+        // published frames per second since Start()
+        double fps = 0.0;
+    };
+
+    struct BrokerFrameInfo {
+        // 1 for the first frame, +1 per frame
+        uint64_t sequence = 0;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        uint32_t bytesCovered = 0;
+        // CLOCK_MONOTONIC (steady_clock) nanoseconds at publication
+        uint64_t publishedNs = 0;
+    };
+
+    // Owns an opened device and streams it through a FrameStream into the shared
+    // ring. Clients get the ring's memfd on connect and map it read-only; a new frame
+    // costs the broker one copy into its slot and one futex wake, independent of the
+    // number of clients. SystemInfo is answered from what the broker was started
+    // with; the device itself is never asked on a client's behalf.
+    //
+    // The frame geometry is fixed for the broker's lifetime; a reopened device is
+    // assumed to have the same screen.
+    class FrameBroker {
+    public:
+        FrameBroker(OpenedDevice device, const SystemInfo& info, const ProtocolConstants& proto,
+                    const BrokerOptions& options);
+        FrameBroker(const FrameBroker&) = delete;
+        FrameBroker& operator=(const FrameBroker&) = delete;
+        // Stops, closes every client and removes the socket file.
+        ~FrameBroker();
+
+        // Creates the shared memory ring and binds the socket (replacing a stale socket
+        // file). False with errno set when either fails.
+        bool Listen();
+        // Starts the capture and client threads; Listen() must have succeeded.
+        void Start();
+        void Stop();
+
+        BrokerStats Stats() const;
+
+    private:
+        void capture_main();
+        void serve_main();
+        // false when the client has to be dropped: hung up, spoke nonsense, or isn't
+        // reading its replies (they never block this thread, a full socket drops it)
+        bool serve_request(int fd);
+        void publish(const std::vector<uint8_t>& rgb565, const CaptureStats& stats);
+        void set_device_lost(bool lost);
+        bool reopen();
+
+        OpenedDevice device_;
+        const SystemInfo info_;
+        ProtocolConstants proto_;
+        const BrokerOptions options_;
+        const size_t frameBytes_;
+
+        AdaptiveTiming timing_;
+        std::unique_ptr<FrameStream> stream_;
+        std::vector<uint8_t> frame_;
+
+        int listenFd_ = -1;
+        int wakeFd_ = -1;
+        int shmFd_ = -1;
+        // O_RDONLY reopen of shmFd_, the one handed to clients
+        int clientShmFd_ = -1;
+        uint8_t* shm_ = nullptr;
+        size_t shmBytes_ = 0;
+        uint64_t sequence_ = 0;
+
+        std::atomic<bool> stop_{false};
+        std::thread captureThread_;
+        std::thread serveThread_;
+
+        mutable std::mutex statsMutex_;
+        BrokerStats stats_{};
+        SteadyClock::time_point startedAt_{};
+    };
+
+    // A process attached to a FrameBroker. Frames are copied out of the shared ring by
+    // the client itself; nothing on the socket carries pixels.
+    class BrokerClient {
+    public:
+        BrokerClient() = default;
+        BrokerClient(const BrokerClient&) = delete;
+        BrokerClient& operator=(const BrokerClient&) = delete;
+        ~BrokerClient();
+
+        bool Connect(const std::string& socketPath);
+        void Close();
+        bool IsConnected() const {
+            return sock_ >= 0;
+        }
+
+        // Round trips to the broker; nullopt once it has gone.
+        std::optional<SystemInfo> GetSystemInfo();
+        std::optional<BrokerStats> GetStats();
+
+        // Copies the newest frame. False when none has been published yet.
+        bool Snapshot(std::vector<uint8_t>& outRgb565, BrokerFrameInfo* info = nullptr) const;
+        // Waits for a frame newer than afterSequence (0: any) and copies it. False on
+        // timeout or when the broker has gone.
+        bool WaitFrame(
+            uint64_t afterSequence,
+            std::vector<uint8_t>& outRgb565,
+            BrokerFrameInfo* info = nullptr,
+            int timeoutMs = 1000) const;
+
+        // The broker has lost the device and has not got it back yet.
+        bool DeviceLost() const;
+
+    private:
+        bool copy_latest(std::vector<uint8_t>& outRgb565, BrokerFrameInfo* info) const;
+        bool broker_gone() const;
+
+        int sock_ = -1;
+        const uint8_t* shm_ = nullptr;
+        size_t shmBytes_ = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,292 @@
+#include "sayo_capture_session.h"
+
+#include <future>
+#include <memory>
+#include <utility>
+
+namespace sayo {
+    const char* SessionStateName(const SessionState state) {
+        switch (state) {
+        case SessionState::Stopped:
+            return "stopped";
+        case SessionState::Running:
+            return "running";
+        case SessionState::Paused:
+            return "paused";
+        case SessionState::Reconnecting:
+            return "reconnecting";
+        case SessionState::Lost:
+            return "lost";
+        case SessionState::GeometryChanged:
+            return "geometry changed";
+        }
+        return "unknown";
+    }
+
+    CaptureSession::CaptureSession(OpenedDevice device, const SystemInfo& info, const CaptureSessionConfig& config)
+        : device_(std::move(device)),
+          info_(info),
+          proto_(config.proto),
+          config_(config),
+          revalidate_(config.revalidateInfo) {
+    }
+
+    CaptureSession::~CaptureSession() {
+        Stop();
+    }
+
+    void CaptureSession::AddFrameSink(FrameSink sink) {
+        if (sink) {
+            frameSinks_.push_back(std::move(sink));
+        }
+    }
+
+    void CaptureSession::SetStateSink(StateSink sink) {
+        stateSink_ = std::move(sink);
+    }
+
+    bool CaptureSession::Start() {
+        if (thread_.joinable() || !device_.transport) {
+            return false;
+        }
+        const FrameMeta& back = frames_.Back().Meta();
+        if (back.width != info_.lcdW || back.height != info_.lcdH) {
+            frames_.Resize(info_.lcdW, info_.lcdH);
+        }
+        scratchIn_.assign(proto_.reportLen22, 0);
+        if (config_.reconnector) {
+            config_.reconnector->Reset();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = false;
+            paused_ = false;
+            stats_ = {};
+            startedAt_ = SteadyClock::now();
+        }
+        store_state(SessionState::Running);
+        thread_ = std::thread([this] { session_main(); });
+        return true;
+    }
+
+    void CaptureSession::Pause() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paused_ = true;
+    }
+
+    void CaptureSession::Resume() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            paused_ = false;
+        }
+        cv_.notify_all();
+    }
+
+    void CaptureSession::Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (config_.reconnector) {
+            config_.reconnector->Cancel();
+        }
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        const SessionState state = State();
+        if (state == SessionState::Running || state == SessionState::Paused || state == SessionState::Reconnecting) {
+            store_state(SessionState::Stopped);
+        }
+    }
+
+    bool CaptureSession::WaitForState(const SessionState state, const std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, timeout, [&] { return State() == state; });
+    }
+
+    CaptureSessionStats CaptureSession::Stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CaptureSessionStats out = stats_;
+        const double secs = std::chrono::duration<double>(SteadyClock::now() - startedAt_).count();
+        if (secs > 0.0 && startedAt_ != SteadyClock::time_point{}) {
+            out.fps = static_cast<double>(out.frames) / secs;
+        }
+        return out;
+    }
+
+    void CaptureSession::session_main() {
+        CaptureOptions options = config_.capture;
+        options.timing = &timing_;
+
+        // Alive only while a revalidation is outstanding: frames stream through it
+        // while the SystemInfo request waits for its answer.
+        std::unique_ptr<CommandMux> mux;
+        std::future<std::optional<CommandResponse>> pendingInfo;
+
+        while (wait_runnable()) {
+            if (revalidate_ && !mux) {
+                mux = std::make_unique<CommandMux>(*device_.transport, proto_);
+                pendingInfo = mux->Request(proto_.cmdSystemInfo);
+            }
+            Transport& link = mux ? mux->Stream() : *device_.transport;
+
+            // holes show the previous frame instead of whatever the recycled buffer had;
+            // zeroCopy also restores rejected reports from it
+            options.concealFrom = &frames_.LastPublished().Pixels();
+            const CaptureFrameResult r =
+                CaptureScreenFrame(link, info_.lcdW, info_.lcdH, scratchIn_, frames_.Back(), proto_, options);
+
+            if (r == CaptureFrameResult::DeviceError) {
+                // the request dies with the link; a reconnect asks the new one
+                mux.reset();
+                if (reconnect()) {
+                    continue;
+                }
+                if (!stopping()) {
+                    set_state(SessionState::Lost);
+                }
+                return;
+            }
+
+            // The geometry came from the cache: once the device has answered (or the
+            // request timed out), the link goes back to the capture alone.
+            if (mux && pendingInfo.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                const std::optional<CommandResponse> response = pendingInfo.get();
+                mux.reset();
+                revalidate_ = false;
+                if (revalidate_info(response)) {
+                    set_state(SessionState::GeometryChanged);
+                    return;
+                }
+            }
+
+            if (r == CaptureFrameResult::Ok) {
+                deliver();
+            } else {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.noData++;
+            }
+        }
+    }
+
+    bool CaptureSession::wait_runnable() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return false;
+            }
+            if (!paused_) {
+                return true;
+            }
+        }
+        set_state(SessionState::Paused);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return !paused_ || stopping_; });
+            if (stopping_) {
+                return false;
+            }
+        }
+        set_state(SessionState::Running);
+        return true;
+    }
+
+    bool CaptureSession::stopping() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stopping_;
+    }
+
+    bool CaptureSession::reconnect() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.drops++;
+        }
+        device_.transport.reset();
+        if (!config_.reconnector) {
+            return false;
+        }
+        set_state(SessionState::Reconnecting);
+
+        std::optional<OpenedDevice> reopened =
+            config_.reconnector->Reopen(OpenHint{device_.path, device_.usagePage});
+        if (!reopened) {
+            return false;
+        }
+        ProtocolConstants proto = proto_;
+        if (!ConfigureForUsagePage(reopened->usagePage, proto)) {
+            return false;
+        }
+        if (reopened->key != device_.key) {
+            // another device came back; its LCD may differ
+            revalidate_ = true;
+        }
+        device_ = std::move(*reopened);
+        proto_ = proto;
+        scratchIn_.assign(proto_.reportLen22, 0);
+        if (config_.cache && config_.cache->SetLastOpen(OpenHint{device_.path, device_.usagePage})) {
+            (void)config_.cache->Save();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.reconnects++;
+        }
+        set_state(SessionState::Running);
+        return true;
+    }
+
+    bool CaptureSession::revalidate_info(const std::optional<CommandResponse>& response) {
+        std::optional<SystemInfo> info;
+        if (response) {
+            info.emplace();
+            if (!DecodeSystemInfo(response->payload.data(), response->payload.size(), *info)) {
+                info.reset();
+            }
+        }
+        if (!info || info->lcdW == 0 || info->lcdH == 0) {
+            // keep the cached size
+            return false;
+        }
+        if (config_.cache && config_.cache->Store(device_.key, *info)) {
+            (void)config_.cache->Save();
+        }
+        const bool sizeChanged = info->lcdW != info_.lcdW || info->lcdH != info_.lcdH;
+        info_ = *info;
+        return sizeChanged;
+    }
+
+    void CaptureSession::deliver() {
+        Frame& frame = frames_.Back();
+        const bool complete = frame.Complete();
+        frame.Meta().device = device_.key;
+        frames_.Publish();
+
+        SessionFrameInfo frameInfo{};
+        frameInfo.firstAfterReconnect = config_.reconnector && config_.reconnector->NoteFrame();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.frames++;
+            if (!complete) {
+                stats_.framesIncomplete++;
+            }
+        }
+        for (const FrameSink& sink : frameSinks_) {
+            sink(frames_.LastPublished(), frameInfo);
+        }
+    }
+
+    void CaptureSession::set_state(const SessionState state) {
+        store_state(state);
+        if (stateSink_) {
+            stateSink_(state);
+        }
+    }
+
+    void CaptureSession::store_state(const SessionState state) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state_.store(state, std::memory_order_release);
+        }
+        cv_.notify_all();
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "sayo_bringup.h"
+#include "sayo_command_mux.h"
+#include "sayo_frame.h"
+#include "sayo_frame_exchange.h"
+#include "sayo_info_cache.h"
+#include "sayo_reconnect.h"
+#include "sayo_screen_capture.h"
+#include "sayo_timing.h"
+
+namespace sayo {
+    enum class SessionState : uint8_t {
+        // not started, or Stop() returned
+        Stopped,
+        Running,
+        // Pause() took effect: the device is open but nothing is requested
+        Paused,
+        // the device dropped and the Reconnector is looking for it
+        Reconnecting,
+        // the device dropped for good (no Reconnector, or it gave up)
+        Lost,
+        // Revalidation found another LCD size; Info() has it. Stop(), resize, Start().
+        GeometryChanged,
+    };
+
+    const char* SessionStateName(SessionState state);
+
+    struct CaptureSessionConfig {
+        ProtocolConstants proto{};
+        // zeroCopy / maxGapRetries; coverage, timing and concealFrom (the last published
+        // frame) are the session's own
+        CaptureOptions capture{};
+        // Optional. Without it a DeviceError ends the session in Lost.
+        Reconnector* reconnector = nullptr;
+        // Optional. Revalidated SystemInfo is stored here, and a reconnect updates LastOpen.
+        DeviceInfoCache* cache = nullptr;
+        // The SystemInfo passed in came from the cache: ask the device once whether it
+        // still holds. The query shares the link with the first captures through a
+        // CommandMux, so they are not held up by its round trip.
+        bool revalidateInfo = false;
+    };
+
+    // What the session knows about a frame beyond its FrameMeta.
+    struct SessionFrameInfo {
+        // first frame since the device came back (Reconnector::NoteFrame)
+        bool firstAfterReconnect = false;
+    };
+
+    // Counted from the last Start().
+    struct CaptureSessionStats {
+        uint64_t frames = 0;
+        uint64_t framesIncomplete = 0;
+        // captures that timed out without a frame
+        uint64_t noData = 0;
+        uint64_t drops = 0;
+        uint64_t reconnects = 0;
+        double fps = 0.0;
+    };
+
+    // Owns one opened device and captures from it on its own thread until stopped.
+    // Nothing polls: the thread blocks in the capture itself, in the Reconnector, or
+    // on a condition variable while paused, and Pause()/Resume()/Stop() wake it.
+    //
+    // Frames come out two ways, usable together:
+    //  - Frames(), a latest-frame FrameExchange for one consumer (a paint handler);
+    //    frames are captured straight into it, holes filled from the previous one.
+    //  - Frame sinks, called on the session thread with each frame.
+    // Either way a Frame carries its sequence, size, timestamps, coverage and the
+    // key of the device it came from.
+    // State changes go to the state sink, also on the session thread. Neither sink may
+    // call Stop(); post to another thread instead.
+    class CaptureSession {
+    public:
+        // frame is only valid for the call; CopyFrom() it into a pooled Frame to keep it.
+        using FrameSink = std::function<void(const Frame& frame, const SessionFrameInfo& info)>;
+        using StateSink = std::function<void(SessionState state)>;
+
+        CaptureSession(OpenedDevice device, const SystemInfo& info, const CaptureSessionConfig& config = {});
+        CaptureSession(const CaptureSession&) = delete;
+        CaptureSession& operator=(const CaptureSession&) = delete;
+        ~CaptureSession();
+
+        // Only while stopped.
+        void AddFrameSink(FrameSink sink);
+        void SetStateSink(StateSink sink);
+
+        // Sizes Frames() for Info() (zero-filled if the size changed, so not while its
+        // consumer reads) and starts the thread. False when already running or the
+        // device is gone.
+        bool Start();
+        // Parks the thread once the frame in progress is done; Resume() continues.
+        void Pause();
+        void Resume();
+        // Wakes a paused thread or a pending reconnect, waits for the frame in progress
+        // and joins. Leaves the device open; Start() goes on with it.
+        void Stop();
+
+        SessionState State() const {
+            return state_.load(std::memory_order_acquire);
+        }
+        // True once State() == state, false after the timeout.
+        bool WaitForState(SessionState state, std::chrono::milliseconds timeout);
+
+        FrameExchange& Frames() {
+            return frames_;
+        }
+        CaptureSessionStats Stats() const;
+
+        // The session thread changes these on a reconnect or revalidation; read them
+        // from a sink or while stopped.
+        const SystemInfo& Info() const {
+            return info_;
+        }
+        const OpenedDevice& Device() const {
+            return device_;
+        }
+        const ProtocolConstants& Proto() const {
+            return proto_;
+        }
+
+    private:
+        void session_main();
+        // Blocks while paused; false once Stop() was called.
+        bool wait_runnable();
+        bool stopping() const;
+        bool reconnect();
+        // True when the SystemInfo response reports another LCD size than info_.
+        bool revalidate_info(const std::optional<CommandResponse>& response);
+        void deliver();
+        // store_state and tell the state sink
+        void set_state(SessionState state);
+        void store_state(SessionState state);
+
+        OpenedDevice device_;
+        SystemInfo info_{};
+        ProtocolConstants proto_{};
+        const CaptureSessionConfig config_;
+        bool revalidate_ = false;
+
+        std::vector<FrameSink> frameSinks_;
+        StateSink stateSink_;
+
+        // session thread only
+        std::vector<uint8_t> scratchIn_;
+        AdaptiveTiming timing_;
+        FrameExchange frames_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::atomic<SessionState> state_{SessionState::Stopped};
+        bool stopping_ = false;
+        bool paused_ = false;
+        CaptureSessionStats stats_{};
+        SteadyClock::time_point startedAt_{};
+
+        std::thread thread_;
+    };
+}
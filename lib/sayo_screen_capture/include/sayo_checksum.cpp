@@ -0,0 +1,411 @@
+#include "sayo_checksum.h"
+
+#include <chrono>
+#include <random>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SAYO_CHECKSUM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC lets any function use any intrinsic; GCC and Clang want the ISA named per function.
+#if defined(SAYO_CHECKSUM_X86) && !defined(_MSC_VER)
+#define SAYO_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SAYO_TARGET(isa)
+#endif
+
+namespace sayo {
+    namespace {
+        using SumWordsFn = uint16_t (*)(const uint8_t* data, size_t len);
+        using SumBatchFn = void (*)(const uint8_t* data, size_t stride, size_t len, size_t count, uint16_t* sums);
+
+        uint16_t sum_reference(const uint8_t* data, const size_t len) {
+            uint16_t crc = 0;
+            for (size_t i = 0; i < len; i++) {
+                uint16_t contribution = data[i];
+                if ((i & 1u) != 0u) {
+                    contribution = static_cast<uint16_t>(contribution << 8);
+                }
+                crc = static_cast<uint16_t>(crc + contribution);
+            }
+            return crc;
+        }
+
+        uint16_t sum_scalar(const uint8_t* data, const size_t len) {
+            // only the low 16 bits matter, and 2^16 divides 2^32, so wrapping here is harmless
+            uint32_t sum = 0;
+            size_t i = 0;
+            for (; i + 1 < len; i += 2) {
+                sum += static_cast<uint32_t>(data[i]) | (static_cast<uint32_t>(data[i + 1]) << 8);
+            }
+            if (i < len) {
+                sum += data[i];
+            }
+            return static_cast<uint16_t>(sum);
+        }
+
+        template <SumWordsFn Sum>
+        void sum_batch_each(const uint8_t* data, const size_t stride, const size_t len, const size_t count,
+                            uint16_t* sums) {
+            for (size_t r = 0; r < count; r++) {
+                sums[r] = Sum(data + r * stride, len);
+            }
+        }
+
+#if defined(SAYO_CHECKSUM_X86)
+        // x86 is little-endian, so an unaligned load at an even offset holds exactly the
+        // report's words and plain 16-bit lane adds wrap the same way the checksum does.
+        SAYO_TARGET("sse2") uint16_t fold_sse2(__m128i acc) {
+            acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 8));
+            acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 4));
+            acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 2));
+            return static_cast<uint16_t>(_mm_cvtsi128_si32(acc));
+        }
+
+        SAYO_TARGET("sse2") uint16_t sum_sse2(const uint8_t* data, const size_t len) {
+            __m128i a0 = _mm_setzero_si128();
+            __m128i a1 = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 64 <= len; i += 64) {
+                a0 = _mm_add_epi16(a0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+                a1 = _mm_add_epi16(a1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16)));
+                a0 = _mm_add_epi16(a0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 32)));
+                a1 = _mm_add_epi16(a1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 48)));
+            }
+            for (; i + 16 <= len; i += 16) {
+                a0 = _mm_add_epi16(a0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+            }
+            const uint16_t head = fold_sse2(_mm_add_epi16(a0, a1));
+            return static_cast<uint16_t>(head + sum_scalar(data + i, len - i));
+        }
+
+        SAYO_TARGET("avx2") uint16_t sum_avx2(const uint8_t* data, const size_t len) {
+            __m256i a0 = _mm256_setzero_si256();
+            __m256i a1 = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 128 <= len; i += 128) {
+                a0 = _mm256_add_epi16(a0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+                a1 = _mm256_add_epi16(a1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32)));
+                a0 = _mm256_add_epi16(a0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 64)));
+                a1 = _mm256_add_epi16(a1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 96)));
+            }
+            for (; i + 32 <= len; i += 32) {
+                a0 = _mm256_add_epi16(a0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+            }
+            const __m256i acc = _mm256_add_epi16(a0, a1);
+            __m128i half = _mm_add_epi16(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            if (i + 16 <= len) {
+                half = _mm_add_epi16(half, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+                i += 16;
+            }
+            const uint16_t head = fold_sse2(half);
+            return static_cast<uint16_t>(head + sum_scalar(data + i, len - i));
+        }
+
+        // Batches sum two reports side by side, so short reports don't pay a full
+        // horizontal fold each: SSE2 folds both accumulators in one go, AVX2 keeps one
+        // report per 128-bit lane (its byte shifts stay within a lane). Long reports
+        // amortize the fold anyway and run faster through the single-report kernels.
+        constexpr size_t kBatchPairMaxLen = 256;
+
+        SAYO_TARGET("sse2") void sum_batch_sse2(const uint8_t* data, const size_t stride, const size_t len,
+                                                const size_t count, uint16_t* sums) {
+            const size_t vecLen = len & ~size_t{15};
+            size_t r = 0;
+            for (; len <= kBatchPairMaxLen && r + 2 <= count; r += 2) {
+                const uint8_t* a = data + r * stride;
+                const uint8_t* b = a + stride;
+                __m128i accA = _mm_setzero_si128();
+                __m128i accB = _mm_setzero_si128();
+                for (size_t i = 0; i < vecLen; i += 16) {
+                    accA = _mm_add_epi16(accA, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+                    accB = _mm_add_epi16(accB, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+                }
+                // a's 64-bit halves summed in the low half, b's in the high half
+                __m128i acc = _mm_add_epi16(_mm_unpacklo_epi64(accA, accB), _mm_unpackhi_epi64(accA, accB));
+                acc = _mm_add_epi16(acc, _mm_srli_epi64(acc, 32));
+                acc = _mm_add_epi16(acc, _mm_srli_epi64(acc, 16));
+                sums[r] = static_cast<uint16_t>(_mm_extract_epi16(acc, 0) + sum_scalar(a + vecLen, len - vecLen));
+                sums[r + 1] = static_cast<uint16_t>(_mm_extract_epi16(acc, 4) + sum_scalar(b + vecLen, len - vecLen));
+            }
+            for (; r < count; r++) {
+                sums[r] = sum_sse2(data + r * stride, len);
+            }
+        }
+
+        SAYO_TARGET("avx2") __m256i load_pair(const uint8_t* a, const uint8_t* b) {
+            const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+            const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+            return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        }
+
+        SAYO_TARGET("avx2") void sum_batch_avx2(const uint8_t* data, const size_t stride, const size_t len,
+                                                const size_t count, uint16_t* sums) {
+            const size_t vecLen = len & ~size_t{15};
+            size_t r = 0;
+            for (; len <= kBatchPairMaxLen && r + 2 <= count; r += 2) {
+                const uint8_t* a = data + r * stride;
+                const uint8_t* b = a + stride;
+                __m256i acc0 = _mm256_setzero_si256();
+                __m256i acc1 = _mm256_setzero_si256();
+                size_t i = 0;
+                for (; i + 32 <= vecLen; i += 32) {
+                    acc0 = _mm256_add_epi16(acc0, load_pair(a + i, b + i));
+                    acc1 = _mm256_add_epi16(acc1, load_pair(a + i + 16, b + i + 16));
+                }
+                if (i < vecLen) {
+                    acc0 = _mm256_add_epi16(acc0, load_pair(a + i, b + i));
+                }
+                __m256i acc = _mm256_add_epi16(acc0, acc1);
+                acc = _mm256_add_epi16(acc, _mm256_srli_si256(acc, 8));
+                acc = _mm256_add_epi16(acc, _mm256_srli_si256(acc, 4));
+                acc = _mm256_add_epi16(acc, _mm256_srli_si256(acc, 2));
+                sums[r] = static_cast<uint16_t>(_mm256_extract_epi16(acc, 0) + sum_scalar(a + vecLen, len - vecLen));
+                sums[r + 1] =
+                    static_cast<uint16_t>(_mm256_extract_epi16(acc, 8) + sum_scalar(b + vecLen, len - vecLen));
+            }
+            for (; r < count; r++) {
+                sums[r] = sum_avx2(data + r * stride, len);
+            }
+        }
+
+        struct CpuFeatures {
+            bool sse2 = false;
+            bool avx2 = false;
+        };
+
+        void cpuid(const unsigned leaf, const unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+            int r[4]{};
+            __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int k = 0; k < 4; k++) {
+                regs[k] = static_cast<unsigned>(r[k]);
+            }
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        uint64_t xcr0() {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            unsigned lo = 0;
+            unsigned hi = 0;
+            __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+        }
+
+        CpuFeatures detect_cpu() {
+            CpuFeatures f{};
+            unsigned regs[4]{};
+            cpuid(0, 0, regs);
+            const unsigned maxLeaf = regs[0];
+            if (maxLeaf < 1) {
+                return f;
+            }
+            cpuid(1, 0, regs);
+            f.sse2 = (regs[3] & (1u << 26)) != 0;
+            // AVX2 also needs the OS to save the ymm registers (OSXSAVE + XCR0 bits 1, 2)
+            const bool osxsave = (regs[2] & (1u << 27)) != 0;
+            const bool avx = (regs[2] & (1u << 28)) != 0;
+            if (maxLeaf >= 7 && osxsave && avx && (xcr0() & 0x6) == 0x6) {
+                cpuid(7, 0, regs);
+                f.avx2 = (regs[1] & (1u << 5)) != 0;
+            }
+            return f;
+        }
+
+        const CpuFeatures& cpu() {
+            static const CpuFeatures features = detect_cpu();
+            return features;
+        }
+#endif
+
+        SumWordsFn kernel_fn(const ChecksumKernel kernel) {
+            switch (kernel) {
+            case ChecksumKernel::Reference:
+                return sum_reference;
+#if defined(SAYO_CHECKSUM_X86)
+            case ChecksumKernel::Sse2:
+                return cpu().sse2 ? sum_sse2 : sum_scalar;
+            case ChecksumKernel::Avx2:
+                return cpu().avx2 ? sum_avx2 : sum_scalar;
+#endif
+            default:
+                return sum_scalar;
+            }
+        }
+
+        SumBatchFn kernel_batch_fn(const ChecksumKernel kernel) {
+            switch (kernel) {
+            case ChecksumKernel::Reference:
+                return sum_batch_each<sum_reference>;
+#if defined(SAYO_CHECKSUM_X86)
+            case ChecksumKernel::Sse2:
+                return cpu().sse2 ? sum_batch_sse2 : sum_batch_each<sum_scalar>;
+            case ChecksumKernel::Avx2:
+                return cpu().avx2 ? sum_batch_avx2 : sum_batch_each<sum_scalar>;
+#endif
+            default:
+                return sum_batch_each<sum_scalar>;
+            }
+        }
+
+        ChecksumKernel pick_kernel() {
+            if (IsChecksumKernelSupported(ChecksumKernel::Avx2)) {
+                return ChecksumKernel::Avx2;
+            }
+            if (IsChecksumKernelSupported(ChecksumKernel::Sse2)) {
+                return ChecksumKernel::Sse2;
+            }
+            return ChecksumKernel::Scalar;
+        }
+
+        SumWordsFn active_fn() {
+            static const SumWordsFn fn = kernel_fn(ActiveChecksumKernel());
+            return fn;
+        }
+
+        SumBatchFn active_batch_fn() {
+            static const SumBatchFn fn = kernel_batch_fn(ActiveChecksumKernel());
+            return fn;
+        }
+
+        bool matches_reference(const ChecksumKernel kernel) {
+            std::mt19937 rng(0x5a70);
+            std::vector<uint8_t> buf(2048 + 64);
+            const SumWordsFn fn = kernel_fn(kernel);
+            const SumBatchFn batch = kernel_batch_fn(kernel);
+            uint16_t sums[5]{};
+
+            // random bytes, plus all-0xFF (maximum carries) and all-zero buffers
+            for (int pattern = 0; pattern < 3; pattern++) {
+                for (uint8_t& b : buf) {
+                    b = pattern == 0 ? static_cast<uint8_t>(rng()) : (pattern == 1 ? 0xFF : 0x00);
+                }
+                // every length through several vector widths and both parities, at
+                // every alignment of the start pointer (the sum itself always starts on
+                // an even report offset; the pointer need not be aligned)
+                for (size_t start = 0; start < 32; start++) {
+                    for (size_t len = 0; len <= 300; len++) {
+                        if (fn(buf.data() + start, len) != sum_reference(buf.data() + start, len)) {
+                            return false;
+                        }
+                    }
+                }
+                for (const size_t len : {size_t{64}, size_t{1023}, size_t{1024}, size_t{2048}}) {
+                    if (fn(buf.data() + 1, len) != sum_reference(buf.data() + 1, len)) {
+                        return false;
+                    }
+                }
+                // batches: odd and even counts, every length up to a few vectors, odd strides
+                for (size_t len = 0; len <= 200; len++) {
+                    const size_t stride = len + 3;
+                    batch(buf.data() + 1, stride, len, 5, sums);
+                    for (size_t r = 0; r < 5; r++) {
+                        if (sums[r] != sum_reference(buf.data() + 1 + r * stride, len)) {
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    const char* ChecksumKernelName(const ChecksumKernel kernel) {
+        switch (kernel) {
+        case ChecksumKernel::Reference:
+            return "reference";
+        case ChecksumKernel::Scalar:
+            return "scalar";
+        case ChecksumKernel::Sse2:
+            return "sse2";
+        case ChecksumKernel::Avx2:
+            return "avx2";
+        }
+        return "?";
+    }
+
+    bool IsChecksumKernelSupported(const ChecksumKernel kernel) {
+        switch (kernel) {
+        case ChecksumKernel::Reference:
+        case ChecksumKernel::Scalar:
+            return true;
+#if defined(SAYO_CHECKSUM_X86)
+        case ChecksumKernel::Sse2:
+            return cpu().sse2;
+        case ChecksumKernel::Avx2:
+            return cpu().avx2;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    ChecksumKernel ActiveChecksumKernel() {
+        static const ChecksumKernel kernel = pick_kernel();
+        return kernel;
+    }
+
+    std::vector<ChecksumBenchResult> BenchmarkChecksumKernels(const size_t reportLen, const uint32_t reports) {
+        std::vector<ChecksumBenchResult> results;
+
+        // a ring of distinct reports, so the timing isn't one buffer sitting in L1
+        constexpr size_t kBuffers = 64;
+        std::mt19937 rng(1);
+        std::vector<uint8_t> pool(kBuffers * reportLen);
+        for (uint8_t& b : pool) {
+            b = static_cast<uint8_t>(rng());
+        }
+
+        for (const ChecksumKernel kernel :
+             {ChecksumKernel::Reference, ChecksumKernel::Scalar, ChecksumKernel::Sse2, ChecksumKernel::Avx2}) {
+            ChecksumBenchResult r{};
+            r.kernel = kernel;
+            r.supported = IsChecksumKernelSupported(kernel);
+            if (!r.supported) {
+                results.push_back(r);
+                continue;
+            }
+            r.matchesReference = matches_reference(kernel);
+
+            const SumWordsFn fn = kernel_fn(kernel);
+            volatile uint16_t sink = 0;
+            const auto t0 = std::chrono::steady_clock::now();
+            for (uint32_t n = 0; n < reports; n++) {
+                sink = static_cast<uint16_t>(sink + fn(pool.data() + (n % kBuffers) * reportLen, reportLen));
+            }
+            const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (secs > 0.0) {
+                r.reportsPerSecond = static_cast<double>(reports) / secs;
+                r.bytesPerSecond = r.reportsPerSecond * static_cast<double>(reportLen);
+            }
+            results.push_back(r);
+        }
+        return results;
+    }
+
+    namespace detail {
+        uint16_t sum_words_le(const uint8_t* data, const size_t len) {
+            return active_fn()(data, len);
+        }
+
+        uint16_t sum_words_le(const ChecksumKernel kernel, const uint8_t* data, const size_t len) {
+            return kernel_fn(kernel)(data, len);
+        }
+
+        void sum_words_le_batch(const uint8_t* data, const size_t stride, const size_t len, const size_t count,
+                                uint16_t* sums) {
+            active_batch_fn()(data, stride, len, count, sums);
+        }
+    }
+}
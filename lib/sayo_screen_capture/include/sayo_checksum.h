@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Kernels for the HID v2 report checksum (the wrapping sum of little-endian 16-bit
+// words that crc16_sum_words_le, verify_crc and build_report_v2 use). The widest one
+// the CPU supports is picked on first use; every kernel gives the same result as the
+// original byte-at-a-time loop for any input.
+namespace sayo {
+    enum class ChecksumKernel : uint8_t {
+        // the original byte-at-a-time loop, kept as the reference
+        Reference,
+        // portable, one word per step
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    const char* ChecksumKernelName(ChecksumKernel kernel);
+    bool IsChecksumKernelSupported(ChecksumKernel kernel);
+    // What crc16_sum_words_le runs on this machine.
+    ChecksumKernel ActiveChecksumKernel();
+
+    struct ChecksumBenchResult {
+        ChecksumKernel kernel = ChecksumKernel::Reference;
+        bool supported = false;
+        // agreed with Reference on every length/alignment/content case tried
+        bool matchesReference = false;
+        double reportsPerSecond = 0.0;
+        double bytesPerSecond = 0.0;
+    };
+
+    // Checks every supported kernel, single and batched, against Reference (random and
+    // edge-case buffers, all lengths up to a few vectors, odd start offsets), then times each one
+    // summing `reports` reports of reportLen bytes. Meant for a diagnostics page or a
+    // one-off run, not for the capture path.
+    std::vector<ChecksumBenchResult> BenchmarkChecksumKernels(size_t reportLen = 1024, uint32_t reports = 200000);
+
+    namespace detail {
+        // Sum for a buffer starting at an even report offset, with the active kernel.
+        uint16_t sum_words_le(const uint8_t* data, size_t len);
+        // Same with a specific kernel; falls back to Scalar for ones this CPU doesn't support.
+        uint16_t sum_words_le(ChecksumKernel kernel, const uint8_t* data, size_t len);
+        // sums[r] = sum of the len bytes at data + r * stride, for count reports at once.
+        void sum_words_le_batch(const uint8_t* data, size_t stride, size_t len, size_t count, uint16_t* sums);
+    }
+}
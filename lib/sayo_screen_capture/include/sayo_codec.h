@@ -0,0 +1,243 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "sayo_checksum.h"
+#include "sayo_protocol.h"
+#include "sayo_screen_capture.h"
+
+// HID v2 codec specialized for the two report variants the O3C exposes:
+// report id 0x21 / 64-byte reports (usage_page=0xFF11) and report id 0x22 /
+// 1024-byte reports (usage_page=0xFF12). The fixed requests are built, crc
+// included, at compile time, and validation works on the known report length and
+// header size. ProtocolConstants that match neither (tests, other firmware) keep
+// going through the generic functions in sayo_protocol.h.
+namespace sayo {
+    enum class ReportVariant : uint8_t {
+        Generic,
+        Id21Len64,
+        Id22Len1024,
+    };
+
+    // Which specialization the capture functions use for proto. ConfigureForUsagePage
+    // sets up proto for one of the specialized variants.
+    inline ReportVariant SelectReportVariant(const ProtocolConstants& proto) {
+        if (proto.headerSize != 8 || proto.cmdScreenBuffer != detail::kCmdScreenBuffer ||
+            proto.cmdSystemInfo != detail::kCmdSystemInfo) {
+            return ReportVariant::Generic;
+        }
+        if (proto.reportId22 == 0x21 && proto.reportLen22 == 64) {
+            return ReportVariant::Id21Len64;
+        }
+        if (proto.reportId22 == 0x22 && proto.reportLen22 == 1024) {
+            return ReportVariant::Id22Len1024;
+        }
+        return ReportVariant::Generic;
+    }
+
+    inline const char* ReportVariantName(const ReportVariant variant) {
+        switch (variant) {
+        case ReportVariant::Id21Len64:
+            return "0x21/64";
+        case ReportVariant::Id22Len1024:
+            return "0x22/1024";
+        default:
+            return "generic";
+        }
+    }
+
+    namespace detail {
+        template <uint8_t ReportId, size_t ReportLen>
+        struct ReportCodec {
+            static constexpr uint8_t kReportId = ReportId;
+            static constexpr size_t kReportLen = ReportLen;
+            static constexpr size_t kHeaderSize = 8;
+            // ProtocolConstants::echo's default; set_report_echo patches anything else in
+            static constexpr uint8_t kDefaultEcho = 0x03;
+
+            using Report = std::array<uint8_t, ReportLen>;
+
+            // build_report_v2 with an empty body, at compile time.
+            static constexpr Report BuildRequest(const uint8_t cmd, const uint8_t echo = kDefaultEcho,
+                                                 const uint8_t index = 0x00) {
+                Report out{};
+                out[0] = ReportId;
+                out[1] = echo;
+                // header.len = body length + 4
+                out[4] = 0x04;
+                out[6] = cmd;
+                out[7] = index;
+                uint16_t crc = 0;
+                for (size_t i = 0; i < ReportLen; i++) {
+                    crc = static_cast<uint16_t>(crc + ((i & 1u) ? (out[i] << 8) : out[i]));
+                }
+                out[2] = static_cast<uint8_t>(crc & 0xFF);
+                out[3] = static_cast<uint8_t>(crc >> 8);
+                return out;
+            }
+
+            static constexpr Report kScreenBufferRequest = BuildRequest(kCmdScreenBuffer);
+            static constexpr Report kSystemInfoRequest = BuildRequest(kCmdSystemInfo);
+
+            // Word sum of a whole report: a fixed-count loop the compiler unrolls for the
+            // short variant, the dispatched SIMD kernel for the long one.
+            static uint16_t Sum(const uint8_t* report) {
+                if constexpr (ReportLen <= 64) {
+                    uint32_t sum = 0;
+                    for (size_t i = 0; i < ReportLen; i += 2) {
+                        sum += static_cast<uint32_t>(report[i]) | (static_cast<uint32_t>(report[i + 1]) << 8);
+                    }
+                    return static_cast<uint16_t>(sum);
+                } else {
+                    return sum_words_le(report, ReportLen);
+                }
+            }
+
+            static bool VerifyCrc(const uint8_t* report, const size_t len) {
+                if (len != ReportLen) {
+                    // short read; not what the device sends, but keep the generic answer
+                    return verify_crc(report, len, kHeaderSize);
+                }
+                const uint16_t packetCrc = static_cast<uint16_t>(report[2] | (static_cast<uint16_t>(report[3]) << 8));
+                return static_cast<uint16_t>(Sum(report) - packetCrc) == packetCrc;
+            }
+
+            // decode_screen_chunk with the variant's constants.
+            static bool DecodeScreenChunk(const uint8_t* report, const size_t len, ScreenChunk& out) {
+                if (len < kHeaderSize || report[0] != ReportId || report[6] != kCmdScreenBuffer) {
+                    return false;
+                }
+                // a short read isn't what the device sends, but keep the generic answer
+                return DecodeScreenChunk(report, len, len == ReportLen ? Sum(report) : sum_words_le(report, len), out);
+            }
+
+            // Same, with the report's word sum (crc field included) already worked out.
+            static bool DecodeScreenChunk(const uint8_t* report, const size_t len, const uint16_t sum,
+                                          ScreenChunk& out) {
+                if (len < kHeaderSize || report[0] != ReportId || report[6] != kCmdScreenBuffer) {
+                    return false;
+                }
+                const uint16_t packetCrc = static_cast<uint16_t>(report[2] | (static_cast<uint16_t>(report[3]) << 8));
+                if (static_cast<uint16_t>(sum - packetCrc) != packetCrc) {
+                    return false;
+                }
+                // the top 6 bits of the length field carry a status (see parse_header)
+                const size_t dataEnd = static_cast<size_t>((report[4] | (report[5] << 8)) & 0x03FF) + 4;
+                if (dataEnd <= kHeaderSize + 4 || dataEnd > len) {
+                    return false;
+                }
+                out.echo = report[1];
+                out.index = report[7];
+                out.addr = read_u32_le(report + kHeaderSize);
+                out.data = report + kHeaderSize + 4;
+                out.len = dataEnd - kHeaderSize - 4;
+                return true;
+            }
+        };
+
+        using Codec21x64 = ReportCodec<0x21, 64>;
+        using Codec22x1024 = ReportCodec<0x22, 1024>;
+
+        inline bool verify_crc(const ReportVariant variant, const uint8_t* report, const size_t len,
+                               const size_t headerSize) {
+            switch (variant) {
+            case ReportVariant::Id21Len64:
+                return Codec21x64::VerifyCrc(report, len);
+            case ReportVariant::Id22Len1024:
+                return Codec22x1024::VerifyCrc(report, len);
+            default:
+                return verify_crc(report, len, headerSize);
+            }
+        }
+
+        inline bool decode_screen_chunk(const ReportVariant variant, const uint8_t* report, const size_t len,
+                                        const ProtocolConstants& proto, ScreenChunk& out) {
+            switch (variant) {
+            case ReportVariant::Id21Len64:
+                return Codec21x64::DecodeScreenChunk(report, len, out);
+            case ReportVariant::Id22Len1024:
+                return Codec22x1024::DecodeScreenChunk(report, len, out);
+            default:
+                return decode_screen_chunk(report, len, proto, out);
+            }
+        }
+
+        inline bool decode_screen_chunk(const ReportVariant variant, const uint8_t* report, const size_t len,
+                                        const uint16_t sum, const ProtocolConstants& proto, ScreenChunk& out) {
+            switch (variant) {
+            case ReportVariant::Id21Len64:
+                return Codec21x64::DecodeScreenChunk(report, len, sum, out);
+            case ReportVariant::Id22Len1024:
+                return Codec22x1024::DecodeScreenChunk(report, len, sum, out);
+            default:
+                return decode_screen_chunk(report, len, sum, proto, out);
+            }
+        }
+
+        // An empty-body request report for proto. For the specialized variants it points
+        // at the compile-time report and only copies it once the echo has to change;
+        // otherwise it is built at run time like before.
+        class RequestReport {
+        public:
+            RequestReport(const ProtocolConstants& proto, const uint8_t cmd) {
+                const ReportVariant variant = SelectReportVariant(proto);
+                if (variant == ReportVariant::Id21Len64) {
+                    data_ = prebuilt<Codec21x64>(cmd);
+                    len_ = Codec21x64::kReportLen;
+                } else if (variant == ReportVariant::Id22Len1024) {
+                    data_ = prebuilt<Codec22x1024>(cmd);
+                    len_ = Codec22x1024::kReportLen;
+                }
+                if (!data_) {
+                    built_ = build_report_v2(proto.reportId22, proto.echo, cmd, 0x00, {}, proto.headerSize,
+                                             proto.reportLen22);
+                    data_ = built_.data();
+                    len_ = built_.size();
+                }
+                SetEcho(proto.echo);
+            }
+            RequestReport(const RequestReport&) = delete;
+            RequestReport& operator=(const RequestReport&) = delete;
+
+            void SetEcho(const uint8_t echo) {
+                if (data_[1] == echo) {
+                    return;
+                }
+                if (built_.empty() && data_ != copy_.data()) {
+                    std::memcpy(copy_.data(), data_, len_);
+                    data_ = copy_.data();
+                }
+                set_report_echo(const_cast<uint8_t*>(data_), echo);
+            }
+
+            const uint8_t* Data() const {
+                return data_;
+            }
+            size_t Size() const {
+                return len_;
+            }
+
+        private:
+            template <class Codec>
+            static const uint8_t* prebuilt(const uint8_t cmd) {
+                if (cmd == kCmdScreenBuffer) {
+                    return Codec::kScreenBufferRequest.data();
+                }
+                if (cmd == kCmdSystemInfo) {
+                    return Codec::kSystemInfoRequest.data();
+                }
+                return nullptr;
+            }
+
+            const uint8_t* data_ = nullptr;
+            size_t len_ = 0;
+            // a prebuilt report with another echo patched in
+            std::array<uint8_t, Codec22x1024::kReportLen> copy_;
+            std::vector<uint8_t> built_;
+        };
+    }
+}
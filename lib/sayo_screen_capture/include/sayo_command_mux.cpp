@@ -0,0 +1,233 @@
+#include "sayo_command_mux.h"
+#include "sayo_protocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace sayo {
+    CommandMux::CommandMux(Transport& inner, const ProtocolConstants& proto, const size_t streamSlots,
+                           const int idleWaitMs)
+        : inner_(inner),
+          proto_(proto),
+          idleWaitMs_(idleWaitMs),
+          ring_(streamSlots, proto.reportLen22),
+          reader_([this] { reader_main(); }) {
+    }
+
+    CommandMux::~CommandMux() {
+        Stop();
+    }
+
+    void CommandMux::Stop() {
+        stop_.store(true, std::memory_order_relaxed);
+        if (reader_.joinable()) {
+            reader_.join();
+        }
+        fail_all();
+    }
+
+    std::future<std::optional<CommandResponse>> CommandMux::Request(
+        const uint8_t cmd,
+        const std::vector<uint8_t>& body,
+        const uint8_t index) {
+        const uint8_t echo = proto_.tagRequests ? detail::next_echo_tag() : proto_.echo;
+        const std::vector<uint8_t> out = detail::build_report_v2(proto_.reportId22, echo, cmd, index, body,
+                                                                 proto_.headerSize, proto_.reportLen22);
+
+        std::future<std::optional<CommandResponse>> result;
+        {
+            // registered before the write so the reader can't see the response first
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            Pending p;
+            p.cmd = cmd;
+            p.echo = echo;
+            p.deadline = inner_.Now() + std::chrono::milliseconds(proto_.commandTimeoutMs);
+            result = p.promise.get_future();
+            pending_.push_back(std::move(p));
+        }
+        requests_.fetch_add(1, std::memory_order_relaxed);
+
+        if (failed_.load(std::memory_order_acquire) || write(out.data(), out.size(), true) < 0) {
+            fail_all();
+        }
+        return result;
+    }
+
+    int CommandMux::write(const uint8_t* data, const size_t len, const bool control) {
+        if (failed_.load(std::memory_order_acquire)) {
+            return -1;
+        }
+        if (control) {
+            // counted before taking the lock so stream writers already queued on it back off
+            controlWaiting_.fetch_add(1, std::memory_order_acq_rel);
+        }
+        std::unique_lock<std::mutex> lock(writeMutex_);
+        if (!control) {
+            // stream requests wait for queued control requests, which then reach the
+            // device between two frames rather than behind the next one
+            writeCv_.wait(lock, [&] {
+                return controlWaiting_.load(std::memory_order_acquire) == 0;
+            });
+        }
+        const int r = inner_.Write(data, len);
+        if (control) {
+            controlWaiting_.fetch_sub(1, std::memory_order_acq_rel);
+            writeCv_.notify_all();
+        }
+        return r;
+    }
+
+    void CommandMux::reader_main() {
+        std::vector<uint8_t> scratch(ring_.SlotBytes());
+        int waitMs = 0;
+        while (!stop_.load(std::memory_order_relaxed)) {
+            // Read straight into the next stream slot; anything that turns out not to
+            // be a screen buffer report is handled from there and the slot reused.
+            uint8_t* slot = ring_.BeginWrite();
+            const bool full = (slot == nullptr);
+            if (full) {
+                slot = scratch.data();
+            }
+
+            const int r = inner_.ReadTimeout(slot, ring_.SlotBytes(), waitMs);
+            if (r < 0) {
+                failed_.store(true, std::memory_order_release);
+                ring_.Wake();
+                fail_all();
+                return;
+            }
+            expire(inner_.Now());
+            if (r == 0) {
+                waitMs = idleWaitMs_;
+                continue;
+            }
+            waitMs = 0;
+
+            const size_t len = static_cast<size_t>(r);
+            if (len >= proto_.headerSize && slot[6] == proto_.cmdScreenBuffer) {
+                streamReports_.fetch_add(1, std::memory_order_relaxed);
+                if (full) {
+                    streamOverruns_.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    ring_.CommitWrite(len);
+                }
+                continue;
+            }
+            route(slot, len);
+        }
+    }
+
+    void CommandMux::route(const uint8_t* report, const size_t len) {
+        if (len < proto_.headerSize || !detail::verify_crc(report, len, proto_.headerSize)) {
+            return;
+        }
+        const HidHeader h = detail::parse_header(report, len);
+        // some other report on the interface that happens to carry a matching cmd/echo
+        if (h.reportId != proto_.reportId22) {
+            unmatched_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const size_t dataEnd = static_cast<size_t>(h.len) + 4;
+        if (dataEnd < proto_.headerSize || dataEnd > len) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(pendingMutex_);
+        const auto it = std::find_if(pending_.begin(), pending_.end(), [&](const Pending& p) {
+            return p.cmd == h.cmd && detail::echo_matches(h.echo, p.echo, proto_);
+        });
+        if (it == pending_.end()) {
+            lock.unlock();
+            unmatched_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Pending p = std::move(*it);
+        pending_.erase(it);
+        lock.unlock();
+
+        CommandResponse response;
+        response.header = h;
+        response.payload.assign(report + proto_.headerSize, report + dataEnd);
+        responses_.fetch_add(1, std::memory_order_relaxed);
+        p.promise.set_value(std::move(response));
+    }
+
+    void CommandMux::expire(const SteadyClock::time_point now) {
+        std::vector<Pending> expired;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            for (auto it = pending_.begin(); it != pending_.end();) {
+                if (now >= it->deadline) {
+                    expired.push_back(std::move(*it));
+                    it = pending_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (Pending& p : expired) {
+            timeouts_.fetch_add(1, std::memory_order_relaxed);
+            p.promise.set_value(std::nullopt);
+        }
+    }
+
+    void CommandMux::fail_all() {
+        std::deque<Pending> dropped;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            dropped.swap(pending_);
+        }
+        for (Pending& p : dropped) {
+            p.promise.set_value(std::nullopt);
+        }
+    }
+
+    CommandMuxStats CommandMux::Stats() const {
+        CommandMuxStats s{};
+        s.streamReports = streamReports_.load(std::memory_order_relaxed);
+        s.streamOverruns = streamOverruns_.load(std::memory_order_relaxed);
+        s.requests = requests_.load(std::memory_order_relaxed);
+        s.responses = responses_.load(std::memory_order_relaxed);
+        s.timeouts = timeouts_.load(std::memory_order_relaxed);
+        s.unmatched = unmatched_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    int CommandMux::StreamChannel::Write(const uint8_t* data, const size_t len) {
+        return mux_.write(data, len, false);
+    }
+
+    const uint8_t* CommandMux::StreamChannel::next_slot(size_t& len, const int timeoutMs) {
+        const uint8_t* slot = mux_.ring_.Peek(len);
+        if (!slot && timeoutMs > 0 && !mux_.failed_.load(std::memory_order_acquire)) {
+            mux_.ring_.WaitForData(std::chrono::milliseconds(timeoutMs));
+            slot = mux_.ring_.Peek(len);
+        }
+        return slot;
+    }
+
+    int CommandMux::StreamChannel::ReadTimeout(uint8_t* data, const size_t len, const int timeoutMs) {
+        size_t n = 0;
+        const uint8_t* slot = next_slot(n, timeoutMs);
+        if (!slot) {
+            return mux_.failed_.load(std::memory_order_acquire) ? -1 : 0;
+        }
+        n = (std::min)(n, len);
+        std::memcpy(data, slot, n);
+        mux_.ring_.Release();
+        return static_cast<int>(n);
+    }
+
+    int CommandMux::StreamChannel::ReadScatter(const ReadSlice* slices, const size_t count, const int timeoutMs) {
+        size_t n = 0;
+        const uint8_t* slot = next_slot(n, timeoutMs);
+        if (!slot) {
+            return mux_.failed_.load(std::memory_order_acquire) ? -1 : 0;
+        }
+        n = detail::scatter_copy(slot, n, slices, count);
+        mux_.ring_.Release();
+        return static_cast<int>(n);
+    }
+}
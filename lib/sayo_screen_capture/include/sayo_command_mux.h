@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "sayo_report_ring.h"
+#include "sayo_screen_capture.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    struct CommandResponse {
+        HidHeader header{};
+        // header.len based payload, everything after the 8 header bytes
+        std::vector<uint8_t> payload;
+    };
+
+    struct CommandMuxStats {
+        uint64_t streamReports = 0;
+        // screen buffer reports dropped because the stream reader fell behind
+        uint64_t streamOverruns = 0;
+        uint64_t requests = 0;
+        uint64_t responses = 0;
+        uint64_t timeouts = 0;
+        // valid non-stream reports nobody was waiting for, or with another report id
+        uint64_t unmatched = 0;
+    };
+
+    // Shares one vendor collection between frame streaming and other commands.
+    // A reader thread owns the inner transport's read side and routes every report by
+    // cmd (and echo tag, with ProtocolConstants::tagRequests): CMD 0x25 goes to
+    // Stream(), which CaptureScreenFrame / FrameStream use like any transport, and
+    // everything else completes the matching Request(). Control requests are written
+    // ahead of any stream request waiting for the link, so a SystemInfo query
+    // costs at most one frame's worth of latency and no dropped frames.
+    //
+    // Same threading requirement as PipelinedReader: the inner transport must allow
+    // one reader and one writer thread at a time.
+    class CommandMux {
+    public:
+        explicit CommandMux(
+            Transport& inner,
+            const ProtocolConstants& proto = {},
+            size_t streamSlots = 1024,
+            int idleWaitMs = 5);
+        CommandMux(const CommandMux&) = delete;
+        CommandMux& operator=(const CommandMux&) = delete;
+        ~CommandMux();
+
+        // CMD 0x25 traffic only; one consumer thread at a time.
+        Transport& Stream() {
+            return stream_;
+        }
+
+        // Sends cmd at control priority. The future yields the response, or nullopt
+        // after commandTimeoutMs or once the device fails.
+        std::future<std::optional<CommandResponse>> Request(
+            uint8_t cmd,
+            const std::vector<uint8_t>& body = {},
+            uint8_t index = 0);
+
+        // Stops and joins the reader thread; pending requests resolve to nullopt.
+        void Stop();
+
+        CommandMuxStats Stats() const;
+
+    private:
+        class StreamChannel final : public Transport {
+        public:
+            explicit StreamChannel(CommandMux& mux) : mux_(mux) {}
+
+            int Write(const uint8_t* data, size_t len) override;
+            int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) override;
+            int ReadScatter(const ReadSlice* slices, size_t count, int timeoutMs) override;
+            SteadyClock::time_point Now() const override {
+                return mux_.inner_.Now();
+            }
+
+        private:
+            const uint8_t* next_slot(size_t& len, int timeoutMs);
+
+            CommandMux& mux_;
+        };
+
+        struct Pending {
+            uint8_t cmd = 0;
+            uint8_t echo = 0;
+            SteadyClock::time_point deadline{};
+            std::promise<std::optional<CommandResponse>> promise;
+        };
+
+        int write(const uint8_t* data, size_t len, bool control);
+        void reader_main();
+        void route(const uint8_t* report, size_t len);
+        void expire(SteadyClock::time_point now);
+        void fail_all();
+
+        Transport& inner_;
+        const ProtocolConstants proto_;
+        const int idleWaitMs_;
+        ReportRing ring_;
+        StreamChannel stream_{*this};
+
+        std::mutex writeMutex_;
+        std::condition_variable writeCv_;
+        std::atomic<uint32_t> controlWaiting_{0};
+
+        mutable std::mutex pendingMutex_;
+        std::deque<Pending> pending_;
+
+        std::atomic<bool> stop_{false};
+        std::atomic<bool> failed_{false};
+        std::atomic<uint64_t> streamReports_{0};
+        std::atomic<uint64_t> streamOverruns_{0};
+        std::atomic<uint64_t> requests_{0};
+        std::atomic<uint64_t> responses_{0};
+        std::atomic<uint64_t> timeouts_{0};
+        std::atomic<uint64_t> unmatched_{0};
+
+        std::thread reader_;
+    };
+}
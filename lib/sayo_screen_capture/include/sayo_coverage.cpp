@@ -0,0 +1,97 @@
+#include "sayo_coverage.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace sayo {
+    namespace {
+        // bits [lo, hi) of a word, 0 <= lo < hi <= 64
+        uint64_t bit_range(const size_t lo, const size_t hi) {
+            const uint64_t upper = hi >= 64 ? ~0ull : ((1ull << hi) - 1);
+            return upper & ~((1ull << lo) - 1);
+        }
+    }
+
+    void CoverageMap::Reset(const size_t bytes) {
+        bytes_ = bytes;
+        covered_ = 0;
+        words_.assign((bytes + 63) / 64, 0);
+    }
+
+    void CoverageMap::Mark(const size_t begin, size_t end) {
+        end = (std::min)(end, bytes_);
+        for (size_t i = begin; i < end;) {
+            const size_t word = i / 64;
+            const size_t hi = (std::min)(end - word * 64, static_cast<size_t>(64));
+            const uint64_t mask = bit_range(i % 64, hi);
+            covered_ += static_cast<size_t>(std::popcount(mask & ~words_[word]));
+            words_[word] |= mask;
+            i = word * 64 + hi;
+        }
+    }
+
+    bool CoverageMap::Any(const size_t begin, size_t end) const {
+        end = (std::min)(end, bytes_);
+        for (size_t i = begin; i < end;) {
+            const size_t word = i / 64;
+            const size_t hi = (std::min)(end - word * 64, static_cast<size_t>(64));
+            if ((words_[word] & bit_range(i % 64, hi)) != 0) {
+                return true;
+            }
+            i = word * 64 + hi;
+        }
+        return false;
+    }
+
+    bool CoverageMap::NextMissing(const size_t from, size_t& begin, size_t& end) const {
+        return NextMissing(from, bytes_, begin, end);
+    }
+
+    bool CoverageMap::NextMissing(const size_t from, size_t limit, size_t& begin, size_t& end) const {
+        if (covered_ == bytes_) {
+            return false;
+        }
+        limit = (std::min)(limit, bytes_);
+        // first clear bit at or after `from`
+        size_t i = from;
+        while (i < limit) {
+            const uint64_t clear = ~words_[i / 64] & bit_range(i % 64, 64);
+            if (clear != 0) {
+                i = (i / 64) * 64 + static_cast<size_t>(std::countr_zero(clear));
+                break;
+            }
+            i = (i / 64 + 1) * 64;
+        }
+        if (i >= limit) {
+            return false;
+        }
+        begin = i;
+        // then the first set bit after it
+        while (i < limit) {
+            const uint64_t set = words_[i / 64] & bit_range(i % 64, 64);
+            if (set != 0) {
+                i = (i / 64) * 64 + static_cast<size_t>(std::countr_zero(set));
+                break;
+            }
+            i = (i / 64 + 1) * 64;
+        }
+        end = (std::min)(i, limit);
+        return true;
+    }
+
+    size_t ConcealMissing(std::vector<uint8_t>& frame, const CoverageMap& coverage,
+                          const std::vector<uint8_t>& previous) {
+        if (frame.size() != coverage.Size() || previous.size() != frame.size()) {
+            return 0;
+        }
+        size_t filled = 0;
+        size_t begin = 0;
+        size_t end = 0;
+        while (coverage.NextMissing(end, begin, end)) {
+            std::memcpy(frame.data() + begin, previous.data() + begin, end - begin);
+            filled += end - begin;
+        }
+        return filled;
+    }
+}
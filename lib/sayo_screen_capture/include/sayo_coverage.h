@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sayo {
+    // Which bytes of a frame actually arrived, one bit per byte. Storage is kept across
+    // Reset() calls with the same size, so reusing one map per capture loop doesn't allocate.
+    class CoverageMap {
+    public:
+        void Reset(size_t bytes);
+
+        // Marks [begin, end) as received; anything past Size() is ignored.
+        void Mark(size_t begin, size_t end);
+        // Whether any byte of [begin, end) has been received.
+        bool Any(size_t begin, size_t end) const;
+
+        size_t Size() const {
+            return bytes_;
+        }
+        size_t Covered() const {
+            return covered_;
+        }
+        bool Full() const {
+            return covered_ == bytes_;
+        }
+
+        // Finds the first missing range at or after `from`. Returns false when there is none.
+        bool NextMissing(size_t from, size_t& begin, size_t& end) const;
+        // Same, looking no further than limit; end stops there too.
+        bool NextMissing(size_t from, size_t limit, size_t& begin, size_t& end) const;
+
+    private:
+        std::vector<uint64_t> words_;
+        size_t bytes_ = 0;
+        size_t covered_ = 0;
+    };
+
+    // Copies every range `coverage` has no data for from `previous` into `frame`, so a
+    // frame with holes shows the last good image there instead of black. Returns the
+    // number of bytes filled; 0 if the sizes don't match.
+    size_t ConcealMissing(std::vector<uint8_t>& frame, const CoverageMap& coverage,
+                          const std::vector<uint8_t>& previous);
+}
@@ -0,0 +1,97 @@
+#include "sayo_frame.h"
+
+#include <chrono>
+#include <utility>
+
+namespace sayo {
+    Frame::Frame(const uint16_t width, const uint16_t height) {
+        Reset(width, height);
+    }
+
+    void Frame::Reset(const uint16_t width, const uint16_t height) {
+        const size_t bytes = static_cast<size_t>(width) * static_cast<size_t>(height) * 2;
+        if (pixels_.size() != bytes) {
+            pixels_.assign(bytes, 0);
+        }
+        coverage_.Reset(bytes);
+
+        // keep the device string's storage for the next capture to write into
+        std::string device = std::move(meta_.device);
+        device.clear();
+        meta_ = FrameMeta{};
+        meta_.device = std::move(device);
+        meta_.width = width;
+        meta_.height = height;
+    }
+
+    void Frame::CopyFrom(const Frame& other) {
+        pixels_ = other.pixels_;
+        coverage_ = other.coverage_;
+        meta_ = other.meta_;
+    }
+
+    FramePool::FramePool(const uint16_t width, const uint16_t height, const size_t capacity)
+        : width_(width),
+          height_(height),
+          capacity_(capacity) {
+        free_.reserve(capacity_);
+        for (size_t i = 0; i < capacity_; i++) {
+            free_.emplace_back(width_, height_);
+        }
+    }
+
+    Frame FramePool::Acquire() {
+        Frame frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.acquired++;
+            if (free_.empty()) {
+                stats_.allocated++;
+            } else {
+                frame = std::move(free_.back());
+                free_.pop_back();
+            }
+        }
+        frame.Reset(width_, height_);
+        return frame;
+    }
+
+    void FramePool::Recycle(Frame&& frame) {
+        const size_t bytes = static_cast<size_t>(width_) * static_cast<size_t>(height_) * 2;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frame.Pixels().size() != bytes || free_.size() >= capacity_) {
+            stats_.dropped++;
+            return;
+        }
+        free_.push_back(std::move(frame));
+        stats_.recycled++;
+    }
+
+    size_t FramePool::Available() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return free_.size();
+    }
+
+    FramePoolStats FramePool::Stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    CaptureFrameResult CaptureScreenFrame(Transport& transport, const uint16_t lcdW, const uint16_t lcdH,
+                                          std::vector<uint8_t>& scratchIn, Frame& frame,
+                                          const ProtocolConstants& proto, const CaptureOptions& options) {
+        frame.Reset(lcdW, lcdH);
+        CaptureOptions frameOptions = options;
+        frameOptions.coverage = &frame.Coverage();
+
+        FrameMeta& meta = frame.Meta();
+        meta.startedAt = transport.Now();
+        const CaptureFrameResult result =
+            CaptureScreenFrame(transport, lcdW, lcdH, scratchIn, frame.Pixels(), &meta.stats, proto, frameOptions);
+        meta.finishedAt = transport.Now();
+        meta.firstChunkAt = meta.stats.bytesCovered > 0
+            ? meta.startedAt + std::chrono::microseconds(meta.stats.firstChunkUs)
+            : meta.finishedAt;
+        return result;
+    }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sayo_coverage.h"
+#include "sayo_screen_capture.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    // Everything known about a frame besides its pixels.
+    struct FrameMeta {
+        // numbered by whoever publishes the frame (FrameExchange); 0 until then
+        uint64_t sequence = 0;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        // On the transport's clock: the first request went out, the first chunk landed
+        // (== finishedAt when none did), the capture returned.
+        SteadyClock::time_point startedAt{};
+        SteadyClock::time_point firstChunkAt{};
+        SteadyClock::time_point finishedAt{};
+        CaptureStats stats{};
+        // OpenedDevice::key of the source; empty unless the capturer knows it (CaptureSession)
+        std::string device;
+    };
+
+    // One RGB565 frame (little-endian, 2 bytes/pixel) together with which of its bytes
+    // arrived and where and when it was captured. Move-only: handing a frame on moves
+    // the pixel storage, nothing copies it unless CopyFrom() is called. Give frames
+    // back to a FramePool (or keep capturing into the same one) to reuse the storage.
+    class Frame {
+    public:
+        Frame() = default;
+        // Zero-filled, nothing covered.
+        Frame(uint16_t width, uint16_t height);
+
+        Frame(Frame&&) noexcept = default;
+        Frame& operator=(Frame&&) noexcept = default;
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+
+        // Starts the frame over as width x height: metadata cleared, nothing covered.
+        // Pixels keep their old contents at the same size and are zero-filled
+        // otherwise; no buffer gives up its capacity.
+        void Reset(uint16_t width, uint16_t height);
+
+        // The one explicit copy, into this frame's own storage.
+        void CopyFrom(const Frame& other);
+
+        std::vector<uint8_t>& Pixels() {
+            return pixels_;
+        }
+        const std::vector<uint8_t>& Pixels() const {
+            return pixels_;
+        }
+        CoverageMap& Coverage() {
+            return coverage_;
+        }
+        const CoverageMap& Coverage() const {
+            return coverage_;
+        }
+        FrameMeta& Meta() {
+            return meta_;
+        }
+        const FrameMeta& Meta() const {
+            return meta_;
+        }
+
+        bool Empty() const {
+            return pixels_.empty();
+        }
+        // every byte arrived (concealed ones don't count)
+        bool Complete() const {
+            return !pixels_.empty() && coverage_.Size() == pixels_.size() && coverage_.Full();
+        }
+
+    private:
+        std::vector<uint8_t> pixels_;
+        CoverageMap coverage_;
+        FrameMeta meta_{};
+    };
+
+    struct FramePoolStats {
+        uint64_t acquired = 0;
+        // Acquire() calls that found the pool empty and allocated
+        uint64_t allocated = 0;
+        uint64_t recycled = 0;
+        // Recycle() calls turned away: pool full, or a frame of another size
+        uint64_t dropped = 0;
+    };
+
+    // Frames of one size, for reuse. The pool is filled up front, so as long as no more
+    // than `capacity` frames are out at once neither Acquire() nor Recycle() allocates.
+    // Either may be called from any thread.
+    class FramePool {
+    public:
+        FramePool(uint16_t width, uint16_t height, size_t capacity = 4);
+        FramePool(const FramePool&) = delete;
+        FramePool& operator=(const FramePool&) = delete;
+
+        // Reset() to the pool's size; the pixels still hold whatever they last held.
+        Frame Acquire();
+        // Takes the frame's storage back for a later Acquire().
+        void Recycle(Frame&& frame);
+
+        size_t Available() const;
+        FramePoolStats Stats() const;
+
+    private:
+        const uint16_t width_;
+        const uint16_t height_;
+        const size_t capacity_;
+
+        mutable std::mutex mutex_;
+        // reserved to capacity_, pushing never reallocates
+        std::vector<Frame> free_;
+        FramePoolStats stats_{};
+    };
+
+    // CaptureScreenFrame into a Frame: Reset() to lcdW x lcdH, then pixels, coverage,
+    // stats and timestamps filled in by the capture. options.coverage is ignored in
+    // favour of the frame's own. Capturing into a recycled frame doesn't allocate.
+    CaptureFrameResult CaptureScreenFrame(
+        Transport& transport,
+        uint16_t lcdW,
+        uint16_t lcdH,
+        std::vector<uint8_t>& scratchIn,
+        Frame& frame,
+        const ProtocolConstants& proto = {},
+        const CaptureOptions& options = {});
+}
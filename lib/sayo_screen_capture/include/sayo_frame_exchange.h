@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "sayo_frame.h"
+
+namespace sayo {
+    // Latest-frame handoff between one producer (the capture thread) and one consumer
+    // (a paint handler, an encoder), over three buffers. The producer fills its back
+    // buffer and Publish() trades it for the shared middle one; Acquire() trades the
+    // consumer's front buffer for the middle one when something new was published.
+    // Each side does a single atomic exchange and never waits for the other: a slow
+    // consumer skips frames, a slow producer leaves the consumer on the last one.
+    //
+    // The buffers are Frames, so metadata and coverage travel with the pixels. Every
+    // published frame gets a sequence number (1, 2, ..., in FrameMeta::sequence) so the
+    // consumer can tell whether anything is new without touching pixels.
+    class FrameExchange {
+    public:
+        FrameExchange() = default;
+        FrameExchange(const uint16_t width, const uint16_t height) {
+            Resize(width, height);
+        }
+
+        FrameExchange(const FrameExchange&) = delete;
+        FrameExchange& operator=(const FrameExchange&) = delete;
+
+        // Makes all three buffers zero-filled width x height frames and starts the
+        // sequence over. Only while neither side is using the exchange.
+        void Resize(const uint16_t width, const uint16_t height) {
+            for (auto& buffer : buffers_) {
+                buffer = Frame(width, height);
+            }
+            back_ = 0;
+            lastPublished_ = 1;
+            middle_.store(1, std::memory_order_relaxed);
+            front_ = 2;
+            nextSequence_ = 1;
+            published_.store(0, std::memory_order_release);
+        }
+
+        // Producer: the buffer to capture into. Changes with every Publish().
+        Frame& Back() {
+            return buffers_[back_];
+        }
+
+        // Producer: the frame published last (all zeros before the first). Nothing
+        // writes it until the next Publish(), whoever holds it by now.
+        const Frame& LastPublished() const {
+            return buffers_[lastPublished_];
+        }
+
+        // Producer: hands the back buffer over as the newest frame. Returns its sequence.
+        uint64_t Publish() {
+            const uint64_t sequence = nextSequence_++;
+            buffers_[back_].Meta().sequence = sequence;
+            lastPublished_ = back_;
+            const uint8_t old = middle_.exchange(static_cast<uint8_t>(back_ | kFresh), std::memory_order_acq_rel);
+            back_ = static_cast<uint8_t>(old & kIndexMask);
+            published_.store(sequence, std::memory_order_release);
+            return sequence;
+        }
+
+        // Either side: sequence of the newest published frame; 0 before the first.
+        uint64_t PublishedSequence() const {
+            return published_.load(std::memory_order_acquire);
+        }
+
+        // Consumer: makes the newest published frame the front buffer. Returns false,
+        // leaving the front buffer as it was, when nothing was published since the last call.
+        bool Acquire() {
+            if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) {
+                return false;
+            }
+            const uint8_t old = middle_.exchange(front_, std::memory_order_acq_rel);
+            front_ = static_cast<uint8_t>(old & kIndexMask);
+            return true;
+        }
+
+        // Consumer: the frame taken by the last successful Acquire() (all zeros before).
+        const Frame& Front() const {
+            return buffers_[front_];
+        }
+        uint64_t FrontSequence() const {
+            return buffers_[front_].Meta().sequence;
+        }
+
+    private:
+        static constexpr uint8_t kIndexMask = 0x03;
+        // set in middle_ by Publish, cleared by Acquire
+        static constexpr uint8_t kFresh = 0x04;
+
+        Frame buffers_[3];
+
+        // producer side
+        uint8_t back_ = 0;
+        uint8_t lastPublished_ = 1;
+        uint64_t nextSequence_ = 1;
+
+        // index of the shared buffer, plus kFresh
+        std::atomic<uint8_t> middle_{1};
+        std::atomic<uint64_t> published_{0};
+
+        // consumer side
+        uint8_t front_ = 2;
+    };
+}
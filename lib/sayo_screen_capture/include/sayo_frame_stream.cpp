@@ -0,0 +1,338 @@
+#include "sayo_frame_stream.h"
+#include "sayo_timing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace sayo {
+    namespace {
+        // a few spare frame buffers are enough to cover everything in flight plus the caller's
+        constexpr size_t kMaxSpareBuffers = 4;
+
+        double micros(const SteadyClock::duration d) {
+            return std::chrono::duration<double, std::micro>(d).count();
+        }
+    }
+
+    FrameStream::FrameStream(Transport& transport, const uint16_t lcdW, const uint16_t lcdH,
+                             const ProtocolConstants& proto, const FrameStreamOptions& options)
+        : transport_(transport),
+          proto_(proto),
+          variant_(SelectReportVariant(proto)),
+          options_(options),
+          lcdW_(lcdW),
+          lcdH_(lcdH),
+          frameBytes_(static_cast<size_t>(lcdW) * static_cast<size_t>(lcdH) * 2),
+          request_(proto, proto.cmdScreenBuffer) {
+        scratch_.assign(proto_.reportLen22, 0);
+    }
+
+    std::vector<uint8_t> FrameStream::take_buffer() {
+        if (spare_.empty()) {
+            return std::vector<uint8_t>(frameBytes_, 0);
+        }
+        std::vector<uint8_t> buf = std::move(spare_.back());
+        spare_.pop_back();
+        return buf;
+    }
+
+    bool FrameStream::top_up_requests() {
+        while (inFlight_.size() < 1 + static_cast<size_t>(options_.extraInFlight)) {
+            const bool idle = inFlight_.empty();
+            const uint8_t echo = proto_.tagRequests ? detail::next_echo_tag() : proto_.echo;
+            request_.SetEcho(echo);
+            if (transport_.Write(request_.Data(), request_.Size()) < 0) {
+                return false;
+            }
+            Pending p{};
+            p.rgb565 = take_buffer();
+            p.coverage.Reset(frameBytes_);
+            p.echo = echo;
+            p.idleLink = idle;
+            p.requestAt = transport_.Now();
+            p.activeSince = p.requestAt;
+            inFlight_.push_back(std::move(p));
+            stats_.requests++;
+        }
+        return true;
+    }
+
+    void FrameStream::finish_front() {
+        Pending& f = inFlight_.front();
+        if (f.packets > 0) {
+            transferSumUs_ += micros(f.lastChunkAt - f.firstChunkAt);
+            transferSamples_++;
+            if (f.idleLink) {
+                // only requests sent onto an idle link show the device's real request latency
+                latencySumUs_ += micros(f.firstChunkAt - f.requestAt);
+                latencySamples_++;
+            }
+        }
+        finished_.push_back(std::move(f));
+        inFlight_.pop_front();
+        if (!inFlight_.empty()) {
+            inFlight_.front().activeSince = transport_.Now();
+        }
+    }
+
+    bool FrameStream::route_to_front(const detail::ScreenChunk& chunk) {
+        // The device answers requests in order, so everything queued ahead of the
+        // request a report belongs to is finished, complete or not.
+        if (proto_.tagRequests) {
+            const auto it = std::find_if(inFlight_.begin(), inFlight_.end(), [&](const Pending& p) {
+                return p.echo == chunk.echo;
+            });
+            if (it == inFlight_.end()) {
+                return false;
+            }
+            for (auto n = it - inFlight_.begin(); n > 0; n--) {
+                finish_front();
+            }
+            return true;
+        }
+
+        if (!detail::echo_matches(chunk.echo, proto_.echo, proto_)) {
+            return false;
+        }
+        // untagged: each frame is walked front to back, so an address that doesn't
+        // move forward starts the next request's frame
+        if (inFlight_.front().packets > 0 && chunk.addr <= inFlight_.front().lastAddr) {
+            finish_front();
+        }
+        return !inFlight_.empty();
+    }
+
+    CaptureFrameResult FrameStream::Next(std::vector<uint8_t>& outRgb565, CaptureStats* stats,
+                                         CoverageMap* coverage) {
+        return next(outRgb565, stats, coverage, nullptr);
+    }
+
+    CaptureFrameResult FrameStream::Next(Frame& frame) {
+        return next(frame.Pixels(), &frame.Meta().stats, &frame.Coverage(), &frame.Meta());
+    }
+
+    bool FrameStream::TryNext(std::vector<uint8_t>& outRgb565, CaptureFrameResult& result, CaptureStats* stats,
+                              CoverageMap* coverage) {
+        if (frameBytes_ == 0) {
+            result = CaptureFrameResult::NoData;
+            return true;
+        }
+        if (!started_) {
+            started_ = true;
+            startedAt_ = transport_.Now();
+        }
+        if (!pump(false)) {
+            result = CaptureFrameResult::DeviceError;
+            return true;
+        }
+        if (finished_.empty()) {
+            return false;
+        }
+        result = deliver(outRgb565, stats, coverage, nullptr);
+        return true;
+    }
+
+    SteadyClock::time_point FrameStream::NextDeadline() const {
+        if (frameBytes_ == 0 || !started_ || !finished_.empty() || inFlight_.empty()) {
+            return SteadyClock::time_point::min();
+        }
+        const Pending& front = inFlight_.front();
+        const SteadyClock::time_point quiet = front.packets > 0
+            ? front.lastChunkAt + idle_break()
+            : front.activeSince + first_chunk_timeout();
+        return (std::min)(quiet, front.activeSince + std::chrono::milliseconds(proto_.commandTimeoutMs));
+    }
+
+    SteadyClock::duration FrameStream::idle_break() const {
+        return options_.timing ? options_.timing->IdleBreak(proto_) : std::chrono::milliseconds(proto_.idleBreakMs);
+    }
+
+    SteadyClock::duration FrameStream::first_chunk_timeout() const {
+        return options_.timing
+            ? options_.timing->FirstChunkTimeout(proto_)
+            : std::chrono::milliseconds(proto_.commandTimeoutMs);
+    }
+
+    bool FrameStream::expire_front(const SteadyClock::time_point now) {
+        const Pending& front = inFlight_.front();
+        if (now - front.activeSince >= std::chrono::milliseconds(proto_.commandTimeoutMs)) {
+            finish_front();
+            return true;
+        }
+        if (front.packets > 0 && now - front.lastChunkAt >= idle_break()) {
+            // the device went quiet before the end of the frame, the tail is lost
+            stats_.lostTails++;
+            if (options_.timing) {
+                options_.timing->ObserveSilence(now - front.lastChunkAt);
+            }
+            finish_front();
+            return true;
+        }
+        if (front.packets == 0 && now - front.activeSince >= first_chunk_timeout()) {
+            finish_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool FrameStream::pump(const bool wait) {
+        while (finished_.empty()) {
+            if (!top_up_requests()) {
+                return false;
+            }
+            uint32_t waitMs = 0;
+            if (wait) {
+                const auto now = transport_.Now();
+                if (expire_front(now)) {
+                    continue;
+                }
+                const Pending& front = inFlight_.front();
+                waitMs = front.packets > 0
+                    ? detail::quiet_wait_ms(now - front.lastChunkAt, proto_.readTimeoutMs, idle_break())
+                    : detail::quiet_wait_ms(now - front.activeSince, proto_.readTimeoutMs, first_chunk_timeout());
+            }
+            const int response = transport_.ReadTimeout(scratch_.data(), scratch_.size(), static_cast<int>(waitMs));
+            if (response < 0) {
+                return false;
+            }
+            if (response == 0 && !wait) {
+                // Only now, with the queue found empty, is silence the device's: reports
+                // that sat queued until the caller came back arrived in time.
+                if (expire_front(transport_.Now())) {
+                    continue;
+                }
+                return true;
+            }
+            detail::ScreenChunk chunk{};
+            if (response == 0 || !detail::decode_screen_chunk(variant_, scratch_.data(), static_cast<size_t>(response),
+                                                              proto_, chunk)) {
+                continue;
+            }
+            stats_.reports++;
+            if (!route_to_front(chunk)) {
+                stats_.strayReports++;
+                continue;
+            }
+
+            Pending& f = inFlight_.front();
+            const size_t end = static_cast<size_t>(chunk.addr) + chunk.len;
+            if (end <= f.rgb565.size()) {
+                std::memcpy(f.rgb565.data() + chunk.addr, chunk.data, chunk.len);
+                f.coverage.Mark(chunk.addr, end);
+                f.maxEnd = (std::max)(f.maxEnd, end);
+            }
+            const auto arrived = transport_.Now();
+            const uint32_t missing = f.sequence.Observe(chunk);
+            if (options_.timing) {
+                if (f.packets == 0 && f.idleLink) {
+                    options_.timing->ObserveFirstChunk(arrived - f.requestAt);
+                } else if (f.packets > 0 && missing == 0) {
+                    options_.timing->ObserveInterArrival(arrived - f.lastChunkAt);
+                }
+            }
+            if (f.packets == 0) {
+                f.firstChunkAt = arrived;
+            }
+            f.lastChunkAt = arrived;
+            f.lastAddr = chunk.addr;
+            f.packets++;
+            stats_.gaps += missing;
+            if (f.maxEnd >= frameBytes_) {
+                finish_front();
+                // the next request goes out now, not when the caller comes back for it
+                if (!top_up_requests()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    CaptureFrameResult FrameStream::next(std::vector<uint8_t>& outRgb565, CaptureStats* stats,
+                                         CoverageMap* coverage, FrameMeta* meta) {
+        if (frameBytes_ == 0) {
+            return CaptureFrameResult::NoData;
+        }
+        if (!started_) {
+            started_ = true;
+            startedAt_ = transport_.Now();
+        } else {
+            callerSumUs_ += micros(transport_.Now() - returnedAt_);
+            callerSamples_++;
+        }
+
+        if (!pump(true)) {
+            return CaptureFrameResult::DeviceError;
+        }
+        return deliver(outRgb565, stats, coverage, meta);
+    }
+
+    CaptureFrameResult FrameStream::deliver(std::vector<uint8_t>& outRgb565, CaptureStats* stats,
+                                            CoverageMap* coverage, FrameMeta* meta) {
+        if (stats) {
+            *stats = CaptureStats{};
+        }
+
+        Pending& f = finished_.front();
+        const size_t covered = f.coverage.Covered();
+        const auto end = f.packets > 0 ? f.lastChunkAt : transport_.Now();
+        if (stats) {
+            stats->packets = f.packets;
+            stats->bytesCovered = static_cast<uint32_t>(covered);
+            stats->durationMs = static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(end - f.activeSince).count());
+            if (f.packets > 0) {
+                stats->firstChunkUs = static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(f.firstChunkAt - f.requestAt).count());
+            }
+        }
+        if (meta) {
+            meta->sequence = 0;
+            meta->width = lcdW_;
+            meta->height = lcdH_;
+            meta->startedAt = f.requestAt;
+            meta->firstChunkAt = f.packets > 0 ? f.firstChunkAt : end;
+            meta->finishedAt = end;
+            meta->device.clear();
+        }
+        const CaptureFrameResult result = covered > 0 ? CaptureFrameResult::Ok : CaptureFrameResult::NoData;
+
+        outRgb565.swap(f.rgb565);
+        if (coverage) {
+            std::swap(*coverage, f.coverage);
+        }
+        if (f.rgb565.size() == frameBytes_ && spare_.size() < kMaxSpareBuffers) {
+            spare_.push_back(std::move(f.rgb565));
+        }
+        finished_.pop_front();
+
+        stats_.framesDelivered++;
+        if (covered < frameBytes_) {
+            stats_.framesIncomplete++;
+        }
+        returnedAt_ = transport_.Now();
+        lastDeliveredAt_ = returnedAt_;
+        return result;
+    }
+
+    FrameStreamStats FrameStream::Stats() const {
+        FrameStreamStats s = stats_;
+        const double elapsedUs = micros(lastDeliveredAt_ - startedAt_);
+        if (s.framesDelivered > 0 && elapsedUs > 0.0) {
+            s.fps = static_cast<double>(s.framesDelivered) * 1e6 / elapsedUs;
+        }
+        if (latencySamples_ > 0 && transferSamples_ > 0) {
+            double perFrameUs = latencySumUs_ / static_cast<double>(latencySamples_) +
+                transferSumUs_ / static_cast<double>(transferSamples_);
+            if (callerSamples_ > 0) {
+                perFrameUs += callerSumUs_ / static_cast<double>(callerSamples_);
+            }
+            if (perFrameUs > 0.0) {
+                s.serialFpsEstimate = 1e6 / perFrameUs;
+            }
+        }
+        return s;
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "sayo_codec.h"
+#include "sayo_coverage.h"
+#include "sayo_frame.h"
+#include "sayo_protocol.h"
+#include "sayo_screen_capture.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    struct FrameStreamOptions {
+        // Screen buffer requests kept queued on the device beyond the frame currently
+        // streaming. 0 sends frame N+1's request the moment frame N's last chunk lands;
+        // 1 or more also hides the device's request latency, but needs firmware that
+        // queues requests instead of dropping them.
+        uint32_t extraInFlight = 0;
+        // Learned per-device timing replacing idleBreakMs and the wait for a first chunk.
+        AdaptiveTiming* timing = nullptr;
+    };
+
+    struct FrameStreamStats {
+        uint64_t framesDelivered = 0;
+        // delivered with part of the frame missing (timeout, or the next frame started early)
+        uint64_t framesIncomplete = 0;
+        uint64_t requests = 0;
+        uint64_t reports = 0;
+        // valid CMD 0x25 reports that could not be matched to an outstanding request
+        // (with ProtocolConstants::tagRequests: late reports of an abandoned one)
+        uint64_t strayReports = 0;
+        // chunks found missing by index/address, and frames cut short after idleBreakMs of silence
+        uint64_t gaps = 0;
+        uint64_t lostTails = 0;
+        // delivered frames per second since the first Next()
+        double fps = 0.0;
+        // what CaptureScreenFrame in a loop would reach on the same link: request
+        // latency + transfer time + the caller's own time between frames, all measured
+        double serialFpsEstimate = 0.0;
+    };
+
+    // Pipelined counterpart of calling CaptureScreenFrame in a loop. Keeps the next
+    // screen buffer request outstanding while the current frame streams in, so the
+    // link never sits idle between frames. Each frame is reassembled into its own
+    // buffer; Next() hands over the oldest finished one.
+    //
+    // With ProtocolConstants::tagRequests every request carries its own echo tag and
+    // reports are matched to requests by it; otherwise by request order and address.
+    //
+    // The stream owns the read side of the transport while it exists. Requests still
+    // outstanding when it is destroyed are answered anyway; their reports show up on
+    // the next reader of the transport.
+    class FrameStream {
+    public:
+        FrameStream(
+            Transport& transport,
+            uint16_t lcdW,
+            uint16_t lcdH,
+            const ProtocolConstants& proto = {},
+            const FrameStreamOptions& options = {});
+        FrameStream(const FrameStream&) = delete;
+        FrameStream& operator=(const FrameStream&) = delete;
+
+        // Waits for the next frame and swaps it into outRgb565 (resized to width * height * 2).
+        // Same result codes and stats as CaptureScreenFrame; coverage, if given, receives
+        // exactly which bytes of the frame arrived (see ConcealMissing).
+        CaptureFrameResult Next(
+            std::vector<uint8_t>& outRgb565,
+            CaptureStats* stats = nullptr,
+            CoverageMap* coverage = nullptr);
+        // Same, with pixels, coverage, stats and timestamps swapped or written into frame.
+        // The frame's old pixel storage goes back to the stream for a later frame.
+        CaptureFrameResult Next(Frame& frame);
+        // Next() without waiting, for driving many streams from a few threads: reads only
+        // what the transport already has queued and returns false when that doesn't
+        // finish a frame. Call it when the transport reports readable data
+        // (Transport::SetReadableCallback) and again at NextDeadline(). Deadlines run out
+        // only once the queue has been found empty, so a late call doesn't turn reports
+        // that were waiting into a lost tail.
+        bool TryNext(
+            std::vector<uint8_t>& outRgb565,
+            CaptureFrameResult& result,
+            CaptureStats* stats = nullptr,
+            CoverageMap* coverage = nullptr);
+        // When TryNext() has to run even if nothing arrives, in transport Now() time:
+        // the moment the frame in flight is given up on. time_point::min() when it
+        // already has something to do.
+        SteadyClock::time_point NextDeadline() const;
+
+        FrameStreamStats Stats() const;
+
+    private:
+        struct Pending {
+            std::vector<uint8_t> rgb565;
+            CoverageMap coverage;
+            size_t maxEnd = 0;
+            uint32_t lastAddr = 0;
+            uint32_t packets = 0;
+            uint8_t echo = 0;
+            detail::ChunkSequencer sequence;
+            // the link had nothing else in flight when the request went out
+            bool idleLink = false;
+            SteadyClock::time_point requestAt{};
+            SteadyClock::time_point activeSince{};
+            SteadyClock::time_point firstChunkAt{};
+            SteadyClock::time_point lastChunkAt{};
+        };
+
+        // Next() for both overloads; meta, if given, receives size and timestamps.
+        CaptureFrameResult next(std::vector<uint8_t>& outRgb565, CaptureStats* stats, CoverageMap* coverage,
+                                FrameMeta* meta);
+        // Reads and routes reports until a frame is finished, blocking in the transport up
+        // to the deadlines; without wait, only while reports are queued. false on a device error.
+        bool pump(bool wait);
+        // Finishes the front request if one of its deadlines has passed.
+        bool expire_front(SteadyClock::time_point now);
+        // Hands the oldest finished frame over.
+        CaptureFrameResult deliver(std::vector<uint8_t>& outRgb565, CaptureStats* stats, CoverageMap* coverage,
+                                   FrameMeta* meta);
+        SteadyClock::duration idle_break() const;
+        SteadyClock::duration first_chunk_timeout() const;
+        bool top_up_requests();
+        bool route_to_front(const detail::ScreenChunk& chunk);
+        void finish_front();
+        std::vector<uint8_t> take_buffer();
+
+        Transport& transport_;
+        const ProtocolConstants proto_;
+        const ReportVariant variant_;
+        const FrameStreamOptions options_;
+        const uint16_t lcdW_;
+        const uint16_t lcdH_;
+        const size_t frameBytes_;
+
+        detail::RequestReport request_;
+        std::vector<uint8_t> scratch_;
+        std::deque<Pending> inFlight_;
+        std::deque<Pending> finished_;
+        std::vector<std::vector<uint8_t>> spare_;
+
+        FrameStreamStats stats_{};
+        bool started_ = false;
+        SteadyClock::time_point startedAt_{};
+        SteadyClock::time_point lastDeliveredAt_{};
+        SteadyClock::time_point returnedAt_{};
+        // sums for serialFpsEstimate
+        double latencySumUs_ = 0.0;
+        uint64_t latencySamples_ = 0;
+        double transferSumUs_ = 0.0;
+        uint64_t transferSamples_ = 0;
+        double callerSumUs_ = 0.0;
+        uint64_t callerSamples_ = 0;
+    };
+}
@@ -0,0 +1,95 @@
+#include "sayo_hidapi_bringup.h"
+#include "sayo_protocol.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "hidapi.h"
+
+namespace sayo {
+    namespace {
+        struct Candidate {
+            OpenHint hint;
+            int rank = 0;
+        };
+
+        void collect_candidates(const hid_device_info* devs, const DeviceIds& ids, std::vector<Candidate>& out) {
+            for (const hid_device_info* it = devs; it; it = it->next) {
+                if (!it->path || it->vendor_id != ids.vid || it->product_id != ids.pid) {
+                    continue;
+                }
+                const int rank = detail::vendor_collection_rank(it->interface_number, it->usage_page, it->usage);
+                if (rank < 0) {
+                    continue;
+                }
+                out.push_back(Candidate{OpenHint{it->path, it->usage_page}, rank});
+            }
+        }
+
+        // Serial numbers identify a device on any port; without one, fall back to the
+        // path, which only holds for as long as it stays plugged into the same port.
+        std::string device_key(const DeviceIds& ids, const wchar_t* serial, const std::string& path) {
+            char prefix[16];
+            std::snprintf(prefix, sizeof(prefix), "%04x:%04x:", ids.vid, ids.pid);
+            std::string key = prefix;
+            if (!serial || !*serial) {
+                return key + "path:" + path;
+            }
+            key += "serial:";
+            for (const wchar_t* ch = serial; *ch; ch++) {
+                key.push_back(*ch >= 0x20 && *ch < 0x7F ? static_cast<char>(*ch) : '?');
+            }
+            return key;
+        }
+    }
+
+    std::vector<OpenHint> HidapiBringUpBackend::Enumerate() {
+        std::vector<Candidate> candidates;
+        hid_device_info* devs = hid_enumerate(ids_.vid, ids_.pid);
+        collect_candidates(devs, ids_, candidates);
+        hid_free_enumeration(devs);
+        if (candidates.empty() && (ids_.vid != 0 || ids_.pid != 0)) {
+            devs = hid_enumerate(0, 0);
+            collect_candidates(devs, ids_, candidates);
+            hid_free_enumeration(devs);
+        }
+
+        // ties keep enumeration order, like OpenVendorInterface
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.rank < b.rank;
+        });
+        std::vector<OpenHint> out;
+        out.reserve(candidates.size());
+        for (Candidate& c : candidates) {
+            out.push_back(std::move(c.hint));
+        }
+        return out;
+    }
+
+    std::optional<OpenedDevice> HidapiBringUpBackend::Open(const OpenHint& where) {
+        if (where.path.empty()) {
+            return std::nullopt;
+        }
+        hid_device* handle = hid_open_path(where.path.c_str());
+        if (!handle) {
+            return std::nullopt;
+        }
+        // Paths get reused when devices are replugged, so make sure it is still the
+        // same kind of collection before trusting it.
+        const hid_device_info* info = hid_get_device_info(handle);
+        if (!info || info->vendor_id != ids_.vid || info->product_id != ids_.pid ||
+            info->usage_page != where.usagePage ||
+            detail::vendor_collection_rank(info->interface_number, info->usage_page, info->usage) < 0) {
+            hid_close(handle);
+            return std::nullopt;
+        }
+
+        OpenedDevice opened;
+        opened.path = where.path;
+        opened.usagePage = info->usage_page;
+        opened.key = device_key(ids_, info->serial_number, where.path);
+        opened.transport = std::make_unique<HidapiTransport>(handle, true);
+        return opened;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "sayo_bringup.h"
+#include "sayo_screen_capture.h"
+
+namespace sayo {
+    // BringUpBackend over hidapi. Open() checks the handle with hid_get_device_info
+    // (no device I/O) and hands out an HidapiTransport that closes it. Needs hid_init().
+    class HidapiBringUpBackend final : public BringUpBackend {
+    public:
+        explicit HidapiBringUpBackend(const DeviceIds& ids) : ids_(ids) {}
+
+        // Same ranking as OpenVendorInterface, including the enumerate-everything
+        // fallback when nothing matches the VID/PID.
+        std::vector<OpenHint> Enumerate() override;
+        std::optional<OpenedDevice> Open(const OpenHint& where) override;
+
+    private:
+        DeviceIds ids_;
+    };
+}
@@ -0,0 +1,573 @@
+#include "sayo_hidraw.h"
+
+#if defined(__linux__)
+
+#include "sayo_protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace sayo {
+    namespace {
+        constexpr int kMaxEventsPerWakeup = 16;
+        // hidraw hands out at most HID_MAX_BUFFER_SIZE bytes per report
+        constexpr size_t kLoopReadBytes = 4096;
+        constexpr int kWriteStallMs = 1000;
+
+        bool read_text_file(const std::string& path, std::string& out) {
+            std::ifstream f(path);
+            if (!f) {
+                return false;
+            }
+            std::ostringstream ss;
+            ss << f.rdbuf();
+            out = ss.str();
+            return true;
+        }
+
+        bool read_binary_file(const std::string& path, std::vector<uint8_t>& out) {
+            std::ifstream f(path, std::ios::binary);
+            if (!f) {
+                return false;
+            }
+            out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+            return true;
+        }
+
+        // uevent has a line like HID_ID=0003:00008089:00000009 (bus:vid:pid)
+        bool parse_hid_id(const std::string& uevent, unsigned short& vid, unsigned short& pid) {
+            const size_t pos = uevent.find("HID_ID=");
+            if (pos == std::string::npos) {
+                return false;
+            }
+            unsigned int bus = 0;
+            unsigned int v = 0;
+            unsigned int p = 0;
+            if (std::sscanf(uevent.c_str() + pos + 7, "%x:%x:%x", &bus, &v, &p) != 3) {
+                return false;
+            }
+            vid = static_cast<unsigned short>(v);
+            pid = static_cast<unsigned short>(p);
+            return true;
+        }
+
+        // device -> .../1-1:1.1/0003:8089:0009.0001, and the USB interface directory
+        // one level up carries bInterfaceNumber.
+        int read_interface_number(const std::string& deviceLink) {
+            char resolved[PATH_MAX];
+            if (!realpath(deviceLink.c_str(), resolved)) {
+                return -1;
+            }
+            std::string path(resolved);
+            const size_t slash = path.rfind('/');
+            if (slash == std::string::npos) {
+                return -1;
+            }
+            std::string text;
+            if (!read_text_file(path.substr(0, slash) + "/bInterfaceNumber", text)) {
+                return -1;
+            }
+            return static_cast<int>(std::strtol(text.c_str(), nullptr, 16));
+        }
+
+        unsigned hidraw_number(const std::string& name) {
+            return static_cast<unsigned>(std::strtoul(name.c_str() + 6, nullptr, 10));
+        }
+    }
+
+    HidrawEventLoop::HidrawEventLoop() : readBuf_(kLoopReadBytes) {
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd_ >= 0 && wakeFd_ >= 0) {
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = wakeFd_;
+            epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+        }
+    }
+
+    HidrawEventLoop::~HidrawEventLoop() {
+        if (wakeFd_ >= 0) {
+            close(wakeFd_);
+        }
+        if (epollFd_ >= 0) {
+            close(epollFd_);
+        }
+    }
+
+    bool HidrawEventLoop::IsValid() const {
+        return epollFd_ >= 0 && wakeFd_ >= 0;
+    }
+
+    bool HidrawEventLoop::Add(const int fd, ReportHandler onReport, ErrorHandler onError) {
+        if (!IsValid() || fd < 0) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            return false;
+        }
+        entries_[fd] = Entry{std::move(onReport), std::move(onError)};
+        return true;
+    }
+
+    void HidrawEventLoop::Remove(const int fd) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.erase(fd) > 0) {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+    }
+
+    int HidrawEventLoop::RunOnce(const int timeoutMs) {
+        if (!IsValid()) {
+            return -1;
+        }
+        epoll_event events[kMaxEventsPerWakeup];
+        const int n = epoll_wait(epollFd_, events, kMaxEventsPerWakeup, timeoutMs);
+        if (n < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+        if (n == 0) {
+            return 0;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.wakeups++;
+        int dispatched = 0;
+        for (int i = 0; i < n; i++) {
+            const int fd = events[i].data.fd;
+            if (fd == wakeFd_) {
+                uint64_t drained = 0;
+                (void)read(wakeFd_, &drained, sizeof(drained));
+                continue;
+            }
+            const auto it = entries_.find(fd);
+            if (it == entries_.end()) {
+                continue;
+            }
+
+            // drain everything that is queued right now, one report per read()
+            bool failed = false;
+            for (;;) {
+                const ssize_t r = read(fd, readBuf_.data(), readBuf_.size());
+                stats_.reads++;
+                if (r > 0) {
+                    stats_.reports++;
+                    dispatched++;
+                    it->second.onReport(readBuf_.data(), static_cast<size_t>(r));
+                    continue;
+                }
+                if (r < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                // r == 0 is a hung-up socket stand-in; hidraw itself reports -1/ENODEV
+                if (it->second.onError) {
+                    it->second.onError(r < 0 ? errno : 0);
+                }
+                failed = true;
+                break;
+            }
+            if (failed) {
+                // level-triggered HUP would otherwise wake us forever
+                epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+                entries_.erase(it);
+            }
+        }
+        return dispatched;
+    }
+
+    void HidrawEventLoop::Run() {
+        while (!stop_.load(std::memory_order_acquire)) {
+            if (RunOnce(-1) < 0) {
+                break;
+            }
+        }
+    }
+
+    void HidrawEventLoop::Stop() {
+        stop_.store(true, std::memory_order_release);
+        if (wakeFd_ >= 0) {
+            const uint64_t one = 1;
+            (void)write(wakeFd_, &one, sizeof(one));
+        }
+    }
+
+    HidrawLoopStats HidrawEventLoop::Stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    HidrawTransport::HidrawTransport(const int fd)
+        : fd_(fd),
+          ownLoop_(std::make_unique<HidrawEventLoop>()),
+          slots_(kQueueSlots * kSlotBytes),
+          direct_(kSlotBytes) {
+        attach(*ownLoop_);
+    }
+
+    HidrawTransport::HidrawTransport(const int fd, HidrawEventLoop& sharedLoop)
+        : fd_(fd),
+          slots_(kQueueSlots * kSlotBytes) {
+        attach(sharedLoop);
+    }
+
+    HidrawTransport::~HidrawTransport() {
+        // on_error() clears loop_ from the loop thread; Remove() outside our lock, the
+        // loop holds its own while calling back into us
+        HidrawEventLoop* loop = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            loop = loop_;
+        }
+        if (loop) {
+            loop->Remove(fd_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    void HidrawTransport::attach(HidrawEventLoop& loop) {
+        if (fd_ < 0) {
+            failed_ = true;
+            return;
+        }
+        const int flags = fcntl(fd_, F_GETFL, 0);
+        if (flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) != 0) {
+            failed_ = true;
+            return;
+        }
+        if (!loop.Add(fd_, [this](const uint8_t* data, const size_t len) { on_report(data, len); },
+                      [this](const int err) { on_error(err); })) {
+            failed_ = true;
+            return;
+        }
+        loop_ = &loop;
+    }
+
+    void HidrawTransport::on_report(const uint8_t* data, const size_t len) {
+        queue_report(data, len);
+        notify_readable();
+    }
+
+    void HidrawTransport::queue_report(const uint8_t* data, const size_t len) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == kQueueSlots) {
+            head_ = (head_ + 1) % kQueueSlots;
+            count_--;
+            overruns_++;
+        }
+        const size_t slot = (head_ + count_) % kQueueSlots;
+        const size_t n = (std::min)(len, kSlotBytes);
+        std::memcpy(slots_.data() + slot * kSlotBytes, data, n);
+        slotLens_[slot] = n;
+        count_++;
+        cv_.notify_one();
+    }
+
+    void HidrawTransport::on_error(const int err) {
+        (void)err;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            failed_ = true;
+            loop_ = nullptr; // the loop already dropped us
+            cv_.notify_all();
+        }
+        notify_readable();
+    }
+
+    void HidrawTransport::notify_readable() {
+        std::lock_guard<std::mutex> lock(readableMutex_);
+        if (onReadable_) {
+            onReadable_();
+        }
+    }
+
+    bool HidrawTransport::SetReadableCallback(std::function<void()> onReadable) {
+        if (ownLoop_) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(readableMutex_);
+        onReadable_ = std::move(onReadable);
+        return true;
+    }
+
+    int HidrawTransport::pop_locked(uint8_t* data, const size_t len) {
+        const size_t n = (std::min)(len, slotLens_[head_]);
+        std::memcpy(data, slots_.data() + head_ * kSlotBytes, n);
+        head_ = (head_ + 1) % kQueueSlots;
+        count_--;
+        return static_cast<int>(n);
+    }
+
+    int HidrawTransport::Write(const uint8_t* data, const size_t len) {
+        for (;;) {
+            const ssize_t r = write(fd_, data, len);
+            if (r >= 0) {
+                return static_cast<int>(r);
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return -1;
+            }
+            pollfd pfd{};
+            pfd.fd = fd_;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, kWriteStallMs) <= 0) {
+                return -1;
+            }
+        }
+    }
+
+    int HidrawTransport::ReadTimeout(uint8_t* data, const size_t len, const int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (count_ > 0) {
+            return pop_locked(data, len);
+        }
+        if (failed_) {
+            return -1;
+        }
+
+        if (ownLoop_) {
+            lock.unlock();
+            const int r = ownLoop_->RunOnce((std::max)(timeoutMs, 0));
+            lock.lock();
+            if (count_ > 0) {
+                return pop_locked(data, len);
+            }
+            return (failed_ || r < 0) ? -1 : 0;
+        }
+
+        cv_.wait_for(lock, std::chrono::milliseconds((std::max)(timeoutMs, 0)),
+                     [&] { return count_ > 0 || failed_; });
+        if (count_ > 0) {
+            return pop_locked(data, len);
+        }
+        return failed_ ? -1 : 0;
+    }
+
+    int HidrawTransport::ReadScatter(const ReadSlice* slices, const size_t count, const int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (count_ > 0) {
+            const size_t len = slotLens_[head_];
+            const size_t n = detail::scatter_copy(slots_.data() + head_ * kSlotBytes, len, slices, count);
+            head_ = (head_ + 1) % kQueueSlots;
+            count_--;
+            return static_cast<int>(n);
+        }
+        if (failed_) {
+            return -1;
+        }
+        lock.unlock();
+        if (!ownLoop_) {
+            // a shared loop owns the fd's reads; take the queued copy
+            return Transport::ReadScatter(slices, count, timeoutMs);
+        }
+
+        // hidraw has no readv of its own: the kernel would do one read() per iovec and
+        // each of those dequeues a whole report. Take one report, then scatter it.
+        bool waited = false;
+        for (;;) {
+            const ssize_t r = read(fd_, direct_.data(), direct_.size());
+            if (r > 0) {
+                return static_cast<int>(detail::scatter_copy(direct_.data(), static_cast<size_t>(r), slices, count));
+            }
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                on_error(r < 0 ? errno : 0);
+                return -1;
+            }
+            if (waited || timeoutMs <= 0) {
+                return 0;
+            }
+            pollfd pfd{};
+            pfd.fd = fd_;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, timeoutMs) < 0 && errno != EINTR) {
+                return -1;
+            }
+            waited = true;
+        }
+    }
+
+    uint64_t HidrawTransport::Overruns() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return overruns_;
+    }
+
+    std::vector<std::pair<unsigned short, unsigned short>> ParseTopLevelCollections(
+        const uint8_t* descriptor,
+        const size_t len) {
+        std::vector<std::pair<unsigned short, unsigned short>> out;
+        std::vector<unsigned short> pageStack;
+        unsigned short usagePage = 0;
+        uint32_t usage = 0;
+        bool haveUsage = false;
+        int depth = 0;
+
+        size_t i = 0;
+        while (i < len) {
+            const uint8_t prefix = descriptor[i];
+            if (prefix == 0xFE) {
+                // long item: FE, size, tag, data
+                if (i + 1 >= len) {
+                    break;
+                }
+                i += 3 + descriptor[i + 1];
+                continue;
+            }
+            const size_t sizeCode = prefix & 0x03u;
+            const size_t size = sizeCode == 3 ? 4 : sizeCode;
+            const uint8_t type = (prefix >> 2) & 0x03u;
+            const uint8_t tag = (prefix >> 4) & 0x0Fu;
+            if (i + 1 + size > len) {
+                break;
+            }
+            uint32_t value = 0;
+            for (size_t b = 0; b < size; b++) {
+                value |= static_cast<uint32_t>(descriptor[i + 1 + b]) << (8 * b);
+            }
+            i += 1 + size;
+
+            if (type == 1) { // global
+                if (tag == 0x0) {
+                    usagePage = static_cast<unsigned short>(value);
+                } else if (tag == 0xA) {
+                    pageStack.push_back(usagePage);
+                } else if (tag == 0xB && !pageStack.empty()) {
+                    usagePage = pageStack.back();
+                    pageStack.pop_back();
+                }
+            } else if (type == 2) { // local
+                if (tag == 0x0 && !haveUsage) {
+                    usage = (size == 4) ? value : ((static_cast<uint32_t>(usagePage) << 16) | value);
+                    haveUsage = true;
+                }
+            } else if (type == 0) { // main
+                if (tag == 0xA) {
+                    if (depth == 0 && value == 0x01 && haveUsage) {
+                        out.emplace_back(static_cast<unsigned short>(usage >> 16),
+                                         static_cast<unsigned short>(usage & 0xFFFF));
+                    }
+                    depth++;
+                } else if (tag == 0xC && depth > 0) {
+                    depth--;
+                }
+                haveUsage = false;
+            }
+        }
+        return out;
+    }
+
+    std::vector<HidrawDeviceInfo> EnumerateHidraw(const DeviceIds& ids) {
+        std::vector<HidrawDeviceInfo> out;
+        DIR* dir = opendir("/sys/class/hidraw");
+        if (!dir) {
+            return out;
+        }
+        std::vector<std::string> names;
+        while (const dirent* ent = readdir(dir)) {
+            if (std::strncmp(ent->d_name, "hidraw", 6) == 0) {
+                names.emplace_back(ent->d_name);
+            }
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) {
+            return hidraw_number(a) < hidraw_number(b);
+        });
+
+        for (const std::string& name : names) {
+            const std::string deviceDir = "/sys/class/hidraw/" + name + "/device";
+            std::string uevent;
+            unsigned short vid = 0;
+            unsigned short pid = 0;
+            if (!read_text_file(deviceDir + "/uevent", uevent) || !parse_hid_id(uevent, vid, pid)) {
+                continue;
+            }
+            if ((ids.vid != 0 || ids.pid != 0) && (vid != ids.vid || pid != ids.pid)) {
+                continue;
+            }
+            std::vector<uint8_t> descriptor;
+            if (!read_binary_file(deviceDir + "/report_descriptor", descriptor)) {
+                continue;
+            }
+            const int interfaceNumber = read_interface_number(deviceDir);
+            for (const auto& [usagePage, usage] : ParseTopLevelCollections(descriptor.data(), descriptor.size())) {
+                HidrawDeviceInfo info{};
+                info.path = "/dev/" + name;
+                info.vendorId = vid;
+                info.productId = pid;
+                info.interfaceNumber = interfaceNumber;
+                info.usagePage = usagePage;
+                info.usage = usage;
+                out.push_back(std::move(info));
+            }
+        }
+        return out;
+    }
+
+    HidrawOpenResult OpenHidrawVendorInterface(const DeviceIds& ids, HidrawEventLoop* sharedLoop) {
+        HidrawOpenResult result{};
+        const std::vector<HidrawDeviceInfo> devs = EnumerateHidraw(ids);
+
+        const HidrawDeviceInfo* best = nullptr;
+        int bestRank = -1;
+        for (const HidrawDeviceInfo& it : devs) {
+            const int rank = detail::vendor_collection_rank(it.interfaceNumber, it.usagePage, it.usage);
+            if (rank < 0) {
+                continue;
+            }
+            if (!best || rank < bestRank) {
+                best = &it;
+                bestRank = rank;
+            }
+        }
+        if (!best) {
+            return result;
+        }
+
+        result.openedPath = best->path;
+        result.usagePage = best->usagePage;
+        result.usage = best->usage;
+        result.interfaceNumber = best->interfaceNumber;
+
+        const int fd = open(best->path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            return result;
+        }
+        if (sharedLoop) {
+            result.transport = std::make_unique<HidrawTransport>(fd, *sharedLoop);
+        } else {
+            result.transport = std::make_unique<HidrawTransport>(fd);
+        }
+        return result;
+    }
+}
+
+#endif
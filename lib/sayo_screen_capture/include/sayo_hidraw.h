@@ -0,0 +1,164 @@
+#pragma once
+
+// Direct /dev/hidrawN backend for Linux capture hosts. Skips hidapi's
+// poll()+read() per report: an epoll loop drains every queued report of every
+// ready descriptor per wakeup, and one loop can serve many devices.
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sayo_screen_capture.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    // One top-level application collection of a hidraw node. A node covers a whole
+    // USB interface, so a single path can show up more than once.
+    struct HidrawDeviceInfo {
+        std::string path;
+        unsigned short vendorId = 0;
+        unsigned short productId = 0;
+        int interfaceNumber = -1;
+        unsigned short usagePage = 0;
+        unsigned short usage = 0;
+    };
+
+    struct HidrawLoopStats {
+        uint64_t wakeups = 0;
+        uint64_t reads = 0;
+        uint64_t reports = 0;
+    };
+
+    class HidrawEventLoop {
+    public:
+        using ReportHandler = std::function<void(const uint8_t* data, size_t len)>;
+        // errno of the failed read, or 0 on hangup
+        using ErrorHandler = std::function<void(int err)>;
+
+        HidrawEventLoop();
+        HidrawEventLoop(const HidrawEventLoop&) = delete;
+        HidrawEventLoop& operator=(const HidrawEventLoop&) = delete;
+        ~HidrawEventLoop();
+
+        bool IsValid() const;
+
+        // The fd must already be non-blocking. Handlers run on the thread calling
+        // RunOnce/Run and must not call Add/Remove themselves.
+        bool Add(int fd, ReportHandler onReport, ErrorHandler onError);
+        void Remove(int fd);
+
+        // Waits up to timeoutMs for any descriptor, then reads every ready one until
+        // it would block. Returns the number of reports dispatched, or -1 if epoll failed.
+        int RunOnce(int timeoutMs);
+        // Loops RunOnce until Stop().
+        void Run();
+        // Safe from any thread; wakes a blocked RunOnce.
+        void Stop();
+
+        HidrawLoopStats Stats() const;
+
+    private:
+        struct Entry {
+            ReportHandler onReport;
+            ErrorHandler onError;
+        };
+
+        int epollFd_ = -1;
+        int wakeFd_ = -1;
+        std::atomic<bool> stop_{false};
+        mutable std::mutex mutex_;
+        std::unordered_map<int, Entry> entries_;
+        std::vector<uint8_t> readBuf_;
+        HidrawLoopStats stats_{};
+    };
+
+    class HidrawTransport final : public Transport {
+    public:
+        // Takes ownership of fd (a hidraw node, or any SOCK_SEQPACKET / packet-mode pipe
+        // that keeps report boundaries). Reads drive a private epoll loop inline.
+        explicit HidrawTransport(int fd);
+        // Same, but the fd is served by a shared loop that another thread runs.
+        HidrawTransport(int fd, HidrawEventLoop& sharedLoop);
+        HidrawTransport(const HidrawTransport&) = delete;
+        HidrawTransport& operator=(const HidrawTransport&) = delete;
+        ~HidrawTransport() override;
+
+        int Write(const uint8_t* data, size_t len) override;
+        int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) override;
+        // Reads straight off the fd when nothing is queued and the transport runs its own
+        // loop: one report per read(), scattered from there.
+        int ReadScatter(const ReadSlice* slices, size_t count, int timeoutMs) override;
+
+        // Shared loop only, onReadable then runs on the loop thread; an own loop only reads
+        // while the caller is in ReadTimeout.
+        bool SetReadableCallback(std::function<void()> onReadable) override;
+
+        int Fd() const {
+            return fd_;
+        }
+        // Reports thrown away because the queue was full.
+        uint64_t Overruns() const;
+
+    private:
+        static constexpr size_t kQueueSlots = 64; // same depth as the kernel's hidraw list
+        static constexpr size_t kSlotBytes = 1024;
+
+        void attach(HidrawEventLoop& loop);
+        void on_report(const uint8_t* data, size_t len);
+        void queue_report(const uint8_t* data, size_t len);
+        void on_error(int err);
+        void notify_readable();
+        int pop_locked(uint8_t* data, size_t len);
+
+        int fd_ = -1;
+        std::unique_ptr<HidrawEventLoop> ownLoop_;
+        // set by attach(), cleared by on_error() on the loop thread; read under mutex_
+        HidrawEventLoop* loop_ = nullptr;
+
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<uint8_t> slots_;
+        size_t slotLens_[kQueueSlots]{};
+        size_t head_ = 0;
+        size_t count_ = 0;
+        bool failed_ = false;
+        uint64_t overruns_ = 0;
+        // ReadScatter's report buffer; own loop only, reader thread only
+        std::vector<uint8_t> direct_;
+
+        // taken on the loop thread after mutex_ is released
+        std::mutex readableMutex_;
+        std::function<void()> onReadable_;
+    };
+
+    // Parses the top-level application collections (usage page, usage) out of a raw report descriptor.
+    std::vector<std::pair<unsigned short, unsigned short>> ParseTopLevelCollections(
+        const uint8_t* descriptor,
+        size_t len);
+
+    // Lists hidraw collections matching the device IDs (0/0 matches everything).
+    std::vector<HidrawDeviceInfo> EnumerateHidraw(const DeviceIds& ids);
+
+    struct HidrawOpenResult {
+        std::unique_ptr<HidrawTransport> transport;
+        std::string openedPath;
+        unsigned short usagePage = 0;
+        unsigned short usage = 0;
+        int interfaceNumber = -1;
+    };
+
+    // hidraw counterpart of OpenVendorInterface; picks the collection the same way.
+    // With sharedLoop set, the transport is served by that loop instead of its own.
+    HidrawOpenResult OpenHidrawVendorInterface(const DeviceIds& ids, HidrawEventLoop* sharedLoop = nullptr);
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "sayo_info_cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+namespace sayo {
+    namespace {
+        // Bump when the line format changes; older files are then ignored.
+        constexpr const char* kCacheHeader = "sayomirror-device-info 2";
+        // refresh rate column for firmware that doesn't report one
+        constexpr int kNoRefreshRate = -1;
+
+        bool same_info(const SystemInfo& a, const SystemInfo& b) {
+            return a.lcdW == b.lcdW && a.lcdH == b.lcdH && a.refreshRate == b.refreshRate;
+        }
+
+        // "info <width> <height> <refresh or -1> <key>", key last since it may hold spaces
+        bool parse_info_line(std::istringstream& fields, std::string& key, SystemInfo& info) {
+            unsigned w = 0;
+            unsigned h = 0;
+            int refresh = kNoRefreshRate;
+            if (!(fields >> w >> h >> refresh)) {
+                return false;
+            }
+            std::getline(fields >> std::ws, key);
+            if (key.empty() || w == 0 || h == 0 || w > 0xFFFF || h > 0xFFFF || refresh > 0xFF) {
+                return false;
+            }
+            info = {};
+            info.lcdW = static_cast<uint16_t>(w);
+            info.lcdH = static_cast<uint16_t>(h);
+            if (refresh >= 0) {
+                info.refreshRate = static_cast<uint8_t>(refresh);
+            }
+            return true;
+        }
+
+        // "open <usage page> <path>"
+        bool parse_open_line(std::istringstream& fields, OpenHint& hint) {
+            unsigned usagePage = 0;
+            if (!(fields >> std::hex >> usagePage >> std::dec)) {
+                return false;
+            }
+            hint = {};
+            std::getline(fields >> std::ws, hint.path);
+            if (hint.path.empty() || usagePage > 0xFFFF) {
+                return false;
+            }
+            hint.usagePage = static_cast<unsigned short>(usagePage);
+            return true;
+        }
+    }
+
+    bool DeviceInfoCache::Load(const std::filesystem::path& file) {
+        std::map<std::string, SystemInfo> loaded;
+        std::optional<OpenHint> lastOpen;
+
+        std::error_code ec;
+        if (!file.empty() && std::filesystem::exists(file, ec)) {
+            std::ifstream in(file, std::ios::binary);
+            if (!in) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                file_ = file;
+                return false;
+            }
+            std::string line;
+            // unknown format: start over, the next Save() rewrites it
+            if (std::getline(in, line) && line == kCacheHeader) {
+                while (std::getline(in, line)) {
+                    std::istringstream fields(line);
+                    std::string kind;
+                    fields >> kind;
+                    if (kind == "info") {
+                        std::string key;
+                        SystemInfo info;
+                        if (parse_info_line(fields, key, info)) {
+                            loaded[key] = info;
+                        }
+                    } else if (kind == "open") {
+                        OpenHint hint;
+                        if (parse_open_line(fields, hint)) {
+                            lastOpen = std::move(hint);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_ = file;
+        entries_ = std::move(loaded);
+        lastOpen_ = std::move(lastOpen);
+        return true;
+    }
+
+    bool DeviceInfoCache::Save() const {
+        std::ostringstream text;
+        text << kCacheHeader << "\n";
+        std::filesystem::path file;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (file_.empty()) {
+                return false;
+            }
+            file = file_;
+            if (lastOpen_) {
+                text << "open " << std::hex << lastOpen_->usagePage << std::dec << ' ' << lastOpen_->path << "\n";
+            }
+            for (const auto& [key, info] : entries_) {
+                text << "info " << info.lcdW << ' ' << info.lcdH << ' '
+                     << (info.refreshRate ? static_cast<int>(*info.refreshRate) : kNoRefreshRate) << ' '
+                     << key << "\n";
+            }
+        }
+
+        std::filesystem::path tmp = file;
+        tmp += ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                return false;
+            }
+            out << text.str();
+            if (!out.flush()) {
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, file, ec);
+        if (ec) {
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+        return true;
+    }
+
+    std::optional<SystemInfo> DeviceInfoCache::Find(const std::string& key) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    bool DeviceInfoCache::Store(const std::string& key, const SystemInfo& info) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto [it, inserted] = entries_.try_emplace(key, info);
+        if (inserted) {
+            return true;
+        }
+        if (same_info(it->second, info)) {
+            return false;
+        }
+        it->second = info;
+        return true;
+    }
+
+    std::optional<OpenHint> DeviceInfoCache::LastOpen() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lastOpen_;
+    }
+
+    bool DeviceInfoCache::SetLastOpen(const OpenHint& hint) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (lastOpen_ && lastOpen_->path == hint.path && lastOpen_->usagePage == hint.usagePage) {
+            return false;
+        }
+        lastOpen_ = hint;
+        return true;
+    }
+}
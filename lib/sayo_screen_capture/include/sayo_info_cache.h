@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "sayo_screen_capture.h"
+
+namespace sayo {
+    // SystemInfo results remembered per device across runs, so bring-up can skip the
+    // CMD 0x02 round trip for a device it has seen before, plus the OpenHint of the
+    // last collection opened so it can skip enumeration too. The key is whatever
+    // identifies the device best: its serial number, or its path when it has none.
+    // Cached entries are only a head start; revalidate with TryGetSystemInfo once the
+    // device is streaming and Store() the fresh result.
+    //
+    // Kept as a small text file, one device per line. Thread-safe.
+    class DeviceInfoCache {
+    public:
+        // Binds the cache to file and replaces the in-memory entries with its contents.
+        // A missing file is an empty cache; false only when it exists but can't be read.
+        bool Load(const std::filesystem::path& file);
+        // Writes back to the loaded file through a temporary file, then replaces the old one.
+        bool Save() const;
+
+        std::optional<SystemInfo> Find(const std::string& key) const;
+        // Returns true when the entry is new or differs from what was cached.
+        bool Store(const std::string& key, const SystemInfo& info);
+
+        std::optional<OpenHint> LastOpen() const;
+        // Returns true when it differs from what was cached.
+        bool SetLastOpen(const OpenHint& hint);
+
+    private:
+        std::filesystem::path file_;
+        mutable std::mutex mutex_;
+        std::map<std::string, SystemInfo> entries_;
+        std::optional<OpenHint> lastOpen_;
+    };
+}
@@ -0,0 +1,252 @@
+#include "sayo_multi_capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace sayo {
+    MultiDeviceCapture::MultiDeviceCapture(BringUpBackend& backend, const MultiCaptureConfig& config, FrameSink sink)
+        : backend_(backend),
+          config_(config),
+          sink_(std::move(sink)) {
+    }
+
+    MultiDeviceCapture::~MultiDeviceCapture() {
+        Stop();
+        // no more on_readable() once this returns, before any session goes away
+        for (const auto& s : sessions_) {
+            (void)s->transport->SetReadableCallback({});
+        }
+    }
+
+    size_t MultiDeviceCapture::OpenAll() {
+        size_t added = 0;
+        // Enumerate() is best collection first, so each device's best one wins its key.
+        for (const OpenHint& candidate : backend_.Enumerate()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const bool open = std::any_of(sessions_.begin(), sessions_.end(), [&](const auto& s) {
+                    return s->device.path == candidate.path;
+                });
+                if (open) {
+                    continue;
+                }
+            }
+            std::optional<OpenedDevice> opened = backend_.Open(candidate);
+            if (opened && AddDevice(std::move(*opened))) {
+                added++;
+            }
+        }
+        if (added > 0 && config_.cache) {
+            (void)config_.cache->Save();
+        }
+        return added;
+    }
+
+    bool MultiDeviceCapture::AddDevice(OpenedDevice device) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const bool taken = std::any_of(sessions_.begin(), sessions_.end(), [&](const auto& s) {
+                return s->device.key == device.key;
+            });
+            if (taken) {
+                return false;
+            }
+        }
+
+        auto session = std::make_unique<Session>();
+        session->proto = config_.proto;
+        if (!ConfigureForUsagePage(device.usagePage, session->proto)) {
+            return false;
+        }
+        std::optional<SystemInfo> info = config_.cache ? config_.cache->Find(device.key) : std::nullopt;
+        if (!info) {
+            info = TryGetSystemInfo(*device.transport, session->proto);
+            if (!info || info->lcdW == 0 || info->lcdH == 0) {
+                return false;
+            }
+            if (config_.cache) {
+                (void)config_.cache->Store(device.key, *info);
+            }
+        }
+        session->info = *info;
+        session->device = std::move(device);
+
+        Session& s = *session;
+        const auto notify = [this, &s] { on_readable(s); };
+        s.transport = s.device.transport.get();
+        if (!s.transport->SetReadableCallback(notify)) {
+            // the reader thread blocks in the device so that no worker has to
+            s.reader = std::make_unique<PipelinedReader>(*s.device.transport);
+            s.transport = s.reader.get();
+            (void)s.reader->SetReadableCallback(notify);
+        }
+
+        FrameStreamOptions streamOptions = config_.stream;
+        streamOptions.timing = &s.timing;
+        s.stream = std::make_unique<FrameStream>(*s.transport, s.info.lcdW, s.info.lcdH, s.proto, streamOptions);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.push_back(std::move(session));
+        s.queued = false;
+        if (!workers_.empty()) {
+            // first run sends the first request
+            enqueue_locked(s);
+        }
+        return true;
+    }
+
+    void MultiDeviceCapture::Start() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!workers_.empty()) {
+            return;
+        }
+        stopping_ = false;
+        startedAt_ = SteadyClock::now();
+        runQueue_.clear();
+        for (const auto& s : sessions_) {
+            s->frames = 0;
+            s->framesIncomplete = 0;
+            s->bytes = 0;
+            s->queued = false;
+            if (!s->failed.load(std::memory_order_relaxed)) {
+                enqueue_locked(*s);
+            }
+        }
+        const size_t n = (std::max)(config_.workerThreads, size_t{1});
+        for (size_t i = 0; i < n; i++) {
+            workers_.emplace_back([this] { worker_main(); });
+        }
+    }
+
+    void MultiDeviceCapture::Stop() {
+        std::vector<std::thread> workers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            workers.swap(workers_);
+        }
+        cv_.notify_all();
+        for (std::thread& t : workers) {
+            t.join();
+        }
+    }
+
+    void MultiDeviceCapture::on_readable(Session& session) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session.readable = true;
+        if (!session.queued && !stopping_ && !workers_.empty() && !session.failed.load(std::memory_order_relaxed)) {
+            enqueue_locked(session);
+        }
+    }
+
+    void MultiDeviceCapture::enqueue_locked(Session& session) {
+        session.queued = true;
+        session.dueAt = SteadyClock::time_point::max();
+        runQueue_.push_back(&session);
+        cv_.notify_one();
+    }
+
+    void MultiDeviceCapture::worker_main() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            // sessions that heard nothing until their frame ran out of time
+            const auto now = SteadyClock::now();
+            auto nextDue = SteadyClock::time_point::max();
+            for (const auto& s : sessions_) {
+                if (s->queued) {
+                    continue;
+                }
+                if (s->dueAt <= now) {
+                    enqueue_locked(*s);
+                } else {
+                    nextDue = (std::min)(nextDue, s->dueAt);
+                }
+            }
+            if (runQueue_.empty()) {
+                if (nextDue == SteadyClock::time_point::max()) {
+                    cv_.wait(lock);
+                } else {
+                    cv_.wait_until(lock, nextDue);
+                }
+                continue;
+            }
+            Session* session = runQueue_.front();
+            runQueue_.pop_front();
+            session->readable = false;
+
+            lock.unlock();
+            bool delivered = false;
+            const bool ok = step(*session, delivered);
+            const auto dueAt = ok ? session->stream->NextDeadline() : SteadyClock::time_point::max();
+            lock.lock();
+
+            if (ok && (delivered || session->readable || dueAt == SteadyClock::time_point::min())) {
+                // back of the queue: every other ready device gets a turn first
+                runQueue_.push_back(session);
+                cv_.notify_one();
+            } else {
+                // waits for its transport, or for dueAt
+                session->queued = false;
+                session->dueAt = dueAt;
+            }
+        }
+    }
+
+    bool MultiDeviceCapture::step(Session& session, bool& delivered) {
+        CaptureStats stats{};
+        CaptureFrameResult r = CaptureFrameResult::NoData;
+        if (!session.stream->TryNext(session.frame, r, &stats)) {
+            return true;
+        }
+        if (r == CaptureFrameResult::DeviceError) {
+            session.failed.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        delivered = true;
+        if (r != CaptureFrameResult::Ok) {
+            return true;
+        }
+        session.frames.fetch_add(1, std::memory_order_relaxed);
+        session.bytes.fetch_add(stats.bytesCovered, std::memory_order_relaxed);
+        if (stats.bytesCovered < session.frame.size()) {
+            session.framesIncomplete.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (sink_) {
+            sink_(session.device.key, session.frame, session.info.lcdW, session.info.lcdH);
+        }
+        return true;
+    }
+
+    size_t MultiDeviceCapture::DeviceCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessions_.size();
+    }
+
+    MultiCaptureStats MultiDeviceCapture::Stats() const {
+        MultiCaptureStats out{};
+        std::lock_guard<std::mutex> lock(mutex_);
+        const double secs = std::chrono::duration<double>(SteadyClock::now() - startedAt_).count();
+        uint64_t bytes = 0;
+        for (const auto& s : sessions_) {
+            DeviceCaptureStats d{};
+            d.key = s->device.key;
+            d.path = s->device.path;
+            d.lcdW = s->info.lcdW;
+            d.lcdH = s->info.lcdH;
+            d.frames = s->frames.load(std::memory_order_relaxed);
+            d.framesIncomplete = s->framesIncomplete.load(std::memory_order_relaxed);
+            d.bytes = s->bytes.load(std::memory_order_relaxed);
+            d.failed = s->failed.load(std::memory_order_relaxed);
+            d.fps = secs > 0.0 ? static_cast<double>(d.frames) / secs : 0.0;
+            out.frames += d.frames;
+            bytes += d.bytes;
+            out.devices.push_back(std::move(d));
+        }
+        if (secs > 0.0) {
+            out.fps = static_cast<double>(out.frames) / secs;
+            out.bytesPerSecond = static_cast<double>(bytes) / secs;
+        }
+        return out;
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sayo_bringup.h"
+#include "sayo_frame_stream.h"
+#include "sayo_info_cache.h"
+#include "sayo_pipeline.h"
+#include "sayo_screen_capture.h"
+#include "sayo_timing.h"
+
+namespace sayo {
+    struct MultiCaptureConfig {
+        // Shared by every session. Keep it well below the device count; a session only
+        // holds a worker while it reassembles reports that have already arrived.
+        size_t workerThreads = 2;
+        ProtocolConstants proto{};
+        FrameStreamOptions stream{};
+        // Optional, for SystemInfo; same role as in BringUpOptions.
+        DeviceInfoCache* cache = nullptr;
+    };
+
+    struct DeviceCaptureStats {
+        std::string key;
+        std::string path;
+        uint16_t lcdW = 0;
+        uint16_t lcdH = 0;
+        uint64_t frames = 0;
+        uint64_t framesIncomplete = 0;
+        uint64_t bytes = 0;
+        // frames per second since Start()
+        double fps = 0.0;
+        // stopped after a DeviceError
+        bool failed = false;
+    };
+
+    struct MultiCaptureStats {
+        std::vector<DeviceCaptureStats> devices;
+        uint64_t frames = 0;
+        double fps = 0.0;
+        // screen bytes delivered per second, all devices
+        double bytesPerSecond = 0.0;
+    };
+
+    // Streams any number of devices on a small fixed pool of threads. Every device is
+    // a session with its own FrameStream, which keeps the device's next request
+    // outstanding. No worker blocks in a device: the transport says when reports are
+    // readable (Transport::SetReadableCallback; one that can't gets a PipelinedReader
+    // in front), and only then does the session join the run queue.
+    // A worker takes it, reassembles what is queued with FrameStream::TryNext, hands
+    // finished frames to the sink and lets the session go back to waiting. A session
+    // that hears nothing is woken once at its stream's NextDeadline() to give the
+    // frame up. Sessions are keyed by OpenedDevice::key, so two collections of one
+    // device become one session.
+    class MultiDeviceCapture {
+    public:
+        // Runs on a worker thread; rgb565 is only valid for the call.
+        using FrameSink = std::function<void(const std::string& key, const std::vector<uint8_t>& rgb565,
+                                             uint16_t width, uint16_t height)>;
+
+        MultiDeviceCapture(BringUpBackend& backend, const MultiCaptureConfig& config, FrameSink sink = {});
+        MultiDeviceCapture(const MultiDeviceCapture&) = delete;
+        MultiDeviceCapture& operator=(const MultiDeviceCapture&) = delete;
+        ~MultiDeviceCapture();
+
+        // Enumerates, opens every device not already open and reads its SystemInfo.
+        // Returns the number of sessions added. Call before Start().
+        size_t OpenAll();
+        // Adds an already opened device; false when its key is taken or SystemInfo fails.
+        bool AddDevice(OpenedDevice device);
+
+        void Start();
+        // Joins the workers; sessions stay open and Start() can resume them.
+        void Stop();
+
+        size_t DeviceCount() const;
+        MultiCaptureStats Stats() const;
+
+    private:
+        struct Session {
+            OpenedDevice device;
+            ProtocolConstants proto{};
+            SystemInfo info{};
+            AdaptiveTiming timing;
+            // in front of device.transport when that can't signal readable reports itself
+            std::unique_ptr<PipelinedReader> reader;
+            Transport* transport = nullptr;
+            std::unique_ptr<FrameStream> stream;
+            std::vector<uint8_t> frame;
+
+            // under mutex_: in the run queue or held by a worker (or by AddDevice until
+            // it is in sessions_)
+            bool queued = true;
+            // under mutex_: reports became readable since a worker last took the session
+            bool readable = false;
+            // under mutex_, while not queued: when the stream has to run even without reports
+            SteadyClock::time_point dueAt = SteadyClock::time_point::max();
+
+            // written by whichever worker holds the session, read by Stats()
+            std::atomic<uint64_t> frames{0};
+            std::atomic<uint64_t> framesIncomplete{0};
+            std::atomic<uint64_t> bytes{0};
+            std::atomic<bool> failed{false};
+        };
+
+        void worker_main();
+        // Transport thread: puts the session in the run queue unless it already is.
+        void on_readable(Session& session);
+        // Queues the session; mutex_ held.
+        void enqueue_locked(Session& session);
+        // Reassembles what the session has queued; a finished frame goes to the sink and
+        // sets delivered. false once the device failed.
+        bool step(Session& session, bool& delivered);
+
+        BringUpBackend& backend_;
+        const MultiCaptureConfig config_;
+        FrameSink sink_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<std::unique_ptr<Session>> sessions_;
+        std::deque<Session*> runQueue_;
+        bool stopping_ = false;
+        SteadyClock::time_point startedAt_{};
+
+        std::vector<std::thread> workers_;
+    };
+}
@@ -0,0 +1,177 @@
+#include "sayo_pipeline.h"
+#include "sayo_protocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace sayo {
+    PipelinedReader::PipelinedReader(Transport& inner, const size_t slotCount, const size_t slotBytes,
+                                     const int idleWaitMs)
+        : inner_(inner),
+          ring_(slotCount, slotBytes),
+          idleWaitMs_(idleWaitMs),
+          reader_([this] { reader_main(); }) {
+    }
+
+    PipelinedReader::~PipelinedReader() {
+        Stop();
+    }
+
+    void PipelinedReader::Stop() {
+        stop_.store(true, std::memory_order_relaxed);
+        if (reader_.joinable()) {
+            reader_.join();
+        }
+    }
+
+    void PipelinedReader::reader_main() {
+        std::vector<uint8_t> discard(ring_.SlotBytes());
+        int waitMs = 0;
+        // onReadable_ runs for the first report of a burst, so the consumer starts right
+        // away, and once more when the burst is drained if anything came in after it
+        bool inBurst = false;
+        bool unannounced = false;
+        while (!stop_.load(std::memory_order_relaxed)) {
+            uint8_t* slot = ring_.BeginWrite();
+            const bool full = (slot == nullptr);
+            if (full) {
+                // keep the OS buffer moving even if the consumer stalls; the newest report is lost
+                slot = discard.data();
+            }
+
+            // Non-blocking while reports keep coming; once drained, park in the
+            // transport for a short while instead of spinning.
+            const int r = inner_.ReadTimeout(slot, ring_.SlotBytes(), waitMs);
+            reads_.fetch_add(1, std::memory_order_relaxed);
+            if (r < 0) {
+                failed_.store(true, std::memory_order_release);
+                ring_.Wake();
+                notify_readable();
+                return;
+            }
+            if (r == 0) {
+                if (unannounced) {
+                    notify_readable();
+                }
+                inBurst = false;
+                unannounced = false;
+                waitMs = idleWaitMs_;
+                continue;
+            }
+            waitMs = 0;
+
+            reports_.fetch_add(1, std::memory_order_relaxed);
+            if (full) {
+                overruns_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            ring_.CommitWrite(static_cast<size_t>(r));
+            if (inBurst) {
+                unannounced = true;
+            } else {
+                inBurst = true;
+                notify_readable();
+            }
+            const size_t depth = ring_.Size();
+            if (depth > highWater_.load(std::memory_order_relaxed)) {
+                highWater_.store(depth, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void PipelinedReader::notify_readable() {
+        std::lock_guard<std::mutex> lock(readableMutex_);
+        if (onReadable_) {
+            onReadable_();
+        }
+    }
+
+    bool PipelinedReader::SetReadableCallback(std::function<void()> onReadable) {
+        std::lock_guard<std::mutex> lock(readableMutex_);
+        onReadable_ = std::move(onReadable);
+        return true;
+    }
+
+    int PipelinedReader::Write(const uint8_t* data, const size_t len) {
+        if (failed_.load(std::memory_order_acquire)) {
+            return -1;
+        }
+        return inner_.Write(data, len);
+    }
+
+    const uint8_t* PipelinedReader::next_slot(size_t& len, const int timeoutMs) {
+        const uint8_t* slot = ring_.Peek(len);
+        if (!slot && timeoutMs > 0 && !failed_.load(std::memory_order_acquire)) {
+            ring_.WaitForData(std::chrono::milliseconds(timeoutMs));
+            slot = ring_.Peek(len);
+        }
+        return slot;
+    }
+
+    int PipelinedReader::ReadTimeout(uint8_t* data, const size_t len, const int timeoutMs) {
+        size_t n = 0;
+        const uint8_t* slot = next_slot(n, timeoutMs);
+        if (!slot) {
+            // only report the failure once everything read before it has been consumed
+            return failed_.load(std::memory_order_acquire) ? -1 : 0;
+        }
+        n = (std::min)(n, len);
+        std::memcpy(data, slot, n);
+        ring_.Release();
+        return static_cast<int>(n);
+    }
+
+    int PipelinedReader::ReadScatter(const ReadSlice* slices, const size_t count, const int timeoutMs) {
+        size_t n = 0;
+        const uint8_t* slot = next_slot(n, timeoutMs);
+        if (!slot) {
+            return failed_.load(std::memory_order_acquire) ? -1 : 0;
+        }
+        n = detail::scatter_copy(slot, n, slices, count);
+        ring_.Release();
+        return static_cast<int>(n);
+    }
+
+    int PipelinedReader::DecodeQueued(BatchDecoder& decoder, const FrameTarget& target, const int timeoutMs,
+                                      BatchDecodeStats* stats) {
+        if (stats) {
+            *stats = BatchDecodeStats{};
+        }
+        size_t n = 0;
+        if (!next_slot(n, timeoutMs)) {
+            return failed_.load(std::memory_order_acquire) ? -1 : 0;
+        }
+        // one lap of the ring at most, so a producer that keeps up can't hold the caller here
+        size_t decoded = 0;
+        while (decoded < ring_.Capacity()) {
+            size_t count = 0;
+            const size_t* lens = nullptr;
+            const uint8_t* batch = ring_.PeekBatch(ring_.Capacity() - decoded, count, lens);
+            if (!batch) {
+                break;
+            }
+            const BatchDecodeStats s = decoder.Decode(batch, ring_.SlotBytes(), count, lens, target);
+            ring_.ReleaseBatch(count);
+            decoded += count;
+            if (stats) {
+                stats->applied += s.applied;
+                stats->rejected += s.rejected;
+                stats->bytesApplied += s.bytesApplied;
+                stats->gaps += s.gaps;
+            }
+        }
+        return static_cast<int>(decoded);
+    }
+
+    PipelinedReaderStats PipelinedReader::Stats() const {
+        PipelinedReaderStats s{};
+        s.reports = reports_.load(std::memory_order_relaxed);
+        s.reads = reads_.load(std::memory_order_relaxed);
+        s.overruns = overruns_.load(std::memory_order_relaxed);
+        s.highWater = highWater_.load(std::memory_order_relaxed);
+        return s;
+    }
+}
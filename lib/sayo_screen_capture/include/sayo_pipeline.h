@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "sayo_batch_decoder.h"
+#include "sayo_report_ring.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    struct PipelinedReaderStats {
+        uint64_t reports = 0;
+        uint64_t reads = 0;
+        // reports dropped because the ring was full
+        uint64_t overruns = 0;
+        size_t highWater = 0;
+    };
+
+    // Optional pipelined capture mode. A dedicated thread does nothing but pull reports
+    // off the inner transport, draining everything pending with non-blocking reads
+    // straight into a preallocated SPSC ring, so the OS HID buffer keeps emptying while
+    // the caller validates and reassembles. Pass this wherever a Transport is expected
+    // (CaptureScreenFrame, TryGetLcdSize, ...); writes go straight through.
+    //
+    // Needs a transport that allows one reader and one writer thread at a time, which
+    // hidapi, HidrawTransport and SimulatedDevice all do. Not meant for VirtualClock
+    // runs: the reader thread's timeouts would race the clock forward.
+    class PipelinedReader final : public Transport {
+    public:
+        explicit PipelinedReader(
+            Transport& inner,
+            size_t slotCount = 1024,
+            size_t slotBytes = 1024,
+            int idleWaitMs = 5);
+        PipelinedReader(const PipelinedReader&) = delete;
+        PipelinedReader& operator=(const PipelinedReader&) = delete;
+        ~PipelinedReader() override;
+
+        int Write(const uint8_t* data, size_t len) override;
+        int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) override;
+        // Scatters straight out of the ring slot, no intermediate buffer.
+        int ReadScatter(const ReadSlice* slices, size_t count, int timeoutMs) override;
+        // Runs every report queued so far (waiting up to timeoutMs for the first) through
+        // decoder into target, straight out of the ring a run of slots at a time. Same
+        // contract as ReadTimeout, counting reports instead of bytes. stats, if given,
+        // gets the totals of the call.
+        int DecodeQueued(BatchDecoder& decoder, const FrameTarget& target, int timeoutMs,
+                         BatchDecodeStats* stats = nullptr);
+        // onReadable runs on the reader thread when a burst of reports starts queueing,
+        // again once it has been drained, and when the inner transport fails.
+        bool SetReadableCallback(std::function<void()> onReadable) override;
+        SteadyClock::time_point Now() const override {
+            return inner_.Now();
+        }
+
+        // Stops and joins the reader thread. Called by the destructor.
+        void Stop();
+
+        PipelinedReaderStats Stats() const;
+
+    private:
+        void reader_main();
+        void notify_readable();
+        const uint8_t* next_slot(size_t& len, int timeoutMs);
+
+        Transport& inner_;
+        ReportRing ring_;
+        const int idleWaitMs_;
+        std::atomic<bool> stop_{false};
+        std::atomic<bool> failed_{false};
+
+        std::atomic<uint64_t> reports_{0};
+        std::atomic<uint64_t> reads_{0};
+        std::atomic<uint64_t> overruns_{0};
+        std::atomic<size_t> highWater_{0};
+
+        std::mutex readableMutex_;
+        std::function<void()> onReadable_;
+
+        std::thread reader_;
+    };
+}
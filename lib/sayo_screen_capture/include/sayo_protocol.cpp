@@ -0,0 +1,152 @@
+#include "sayo_protocol.h"
+#include "sayo_checksum.h"
+
+#include <atomic>
+
+namespace sayo::detail {
+    uint16_t crc16_sum_words_le(const uint8_t* data, const size_t len) {
+        return crc16_accumulate(0, data, len, 0);
+    }
+
+    uint16_t crc16_accumulate(uint16_t crc, const uint8_t* data, size_t len, const size_t offset) {
+        if (len == 0) {
+            return crc;
+        }
+        // a piece starting at an odd offset begins with the high half of a word
+        if ((offset & 1u) != 0u) {
+            crc = static_cast<uint16_t>(crc + (static_cast<uint16_t>(data[0]) << 8));
+            data++;
+            len--;
+        }
+        return static_cast<uint16_t>(crc + sum_words_le(data, len));
+    }
+
+    uint8_t next_echo_tag() {
+        static std::atomic<uint32_t> counter{0};
+        for (;;) {
+            const auto tag = static_cast<uint8_t>(counter.fetch_add(1, std::memory_order_relaxed));
+            if (tag != 0x00 && tag != 0x03 && tag != 0x13) {
+                return tag;
+            }
+        }
+    }
+
+    HidHeader parse_header(const uint8_t* report, const size_t reportLen) {
+        (void)reportLen;
+        HidHeader h{};
+        h.reportId = report[0];
+        h.echo = report[1];
+        h.crc = static_cast<uint16_t>(report[2] | (static_cast<uint16_t>(report[3]) << 8));
+        const uint16_t lenField = static_cast<uint16_t>(report[4] | (static_cast<uint16_t>(report[5]) << 8));
+
+        if ((lenField & 0xFC00u) != 0u) {
+            h.status = static_cast<uint8_t>(lenField >> 10);
+            h.len = static_cast<uint16_t>(lenField & 0x03FFu);
+        } else {
+            h.status = 0;
+            h.len = lenField;
+        }
+        h.cmd = report[6];
+        h.index = report[7];
+        return h;
+    }
+
+    bool verify_crc(const uint8_t* report, const size_t reportLen, const size_t headerSize) {
+        if (reportLen < headerSize) {
+            return false;
+        }
+        const uint16_t packetCrc = static_cast<uint16_t>(report[2] | (static_cast<uint16_t>(report[3]) << 8));
+        // sum everything, then take the crc field's own word back out
+        const uint16_t crc = static_cast<uint16_t>(sum_words_le(report, reportLen) - packetCrc);
+        return packetCrc == crc;
+    }
+
+    bool verify_crc_scattered(const ReadSlice* slices, const size_t count, size_t reportLen,
+                              const size_t headerSize) {
+        if (reportLen < headerSize || count == 0 || slices[0].len < 4) {
+            return false;
+        }
+        const uint8_t* head = slices[0].data;
+        const uint16_t packetCrc = static_cast<uint16_t>(head[2] | (static_cast<uint16_t>(head[3]) << 8));
+        uint16_t crc = 0;
+        size_t offset = 0;
+        for (size_t i = 0; i < count && reportLen > 0; i++) {
+            const size_t n = slices[i].len < reportLen ? slices[i].len : reportLen;
+            crc = crc16_accumulate(crc, slices[i].data, n, offset);
+            offset += n;
+            reportLen -= n;
+        }
+        // the crc field was summed too; the checksum is defined with it zeroed
+        crc = static_cast<uint16_t>(crc - packetCrc);
+        return packetCrc == crc;
+    }
+
+    bool decode_screen_chunk(const uint8_t* report, const size_t reportLen, const ProtocolConstants& proto,
+                             ScreenChunk& out) {
+        // don't sum reports that are turned away anyway
+        if (reportLen < proto.headerSize || report[0] != proto.reportId22 || report[6] != proto.cmdScreenBuffer) {
+            return false;
+        }
+        return decode_screen_chunk(report, reportLen, sum_words_le(report, reportLen), proto, out);
+    }
+
+    bool decode_screen_chunk(const uint8_t* report, const size_t reportLen, const uint16_t sum,
+                             const ProtocolConstants& proto, ScreenChunk& out) {
+        if (reportLen < proto.headerSize || reportLen < 4 || report[0] != proto.reportId22 ||
+            report[6] != proto.cmdScreenBuffer) {
+            return false;
+        }
+        // the crc field was summed too; the checksum is defined with it zeroed
+        const uint16_t packetCrc = static_cast<uint16_t>(report[2] | (static_cast<uint16_t>(report[3]) << 8));
+        if (static_cast<uint16_t>(sum - packetCrc) != packetCrc) {
+            return false;
+        }
+        const HidHeader h = parse_header(report, reportLen);
+        const size_t dataEnd = static_cast<size_t>(h.len) + 4;
+        if (dataEnd <= proto.headerSize || dataEnd > reportLen) {
+            return false;
+        }
+        const size_t payloadLen = dataEnd - proto.headerSize;
+        if (payloadLen <= 4) {
+            return false;
+        }
+        out.echo = h.echo;
+        out.index = h.index;
+        out.addr = read_u32_le(report + proto.headerSize);
+        out.data = report + proto.headerSize + 4;
+        out.len = payloadLen - 4;
+        return true;
+    }
+
+    std::vector<uint8_t> build_report_v2(
+        const uint8_t reportId,
+        const uint8_t echo,
+        const uint8_t cmd,
+        const uint8_t index,
+        const std::vector<uint8_t>& body,
+        const size_t headerSize,
+        const size_t reportLen) {
+        std::vector<uint8_t> out(reportLen, 0);
+        out[0] = reportId;
+        out[1] = echo;
+        out[2] = 0;
+        out[3] = 0;
+
+        // sayo_api_rs sets header.len to (body_len + 0x04)
+        const uint16_t lenField = static_cast<uint16_t>(body.size() + 0x04);
+        out[4] = static_cast<uint8_t>(lenField & 0xFF);
+        out[5] = static_cast<uint8_t>((lenField >> 8) & 0xFF);
+        out[6] = cmd;
+        out[7] = index;
+
+        for (size_t i = 0; i < body.size() && (headerSize + i) < out.size(); i++) {
+            out[headerSize + i] = body[i];
+        }
+
+        // Compute CRC with crc field set to 0.
+        const uint16_t crc = crc16_sum_words_le(out.data(), out.size());
+        out[2] = static_cast<uint8_t>(crc & 0xFF);
+        out[3] = static_cast<uint8_t>((crc >> 8) & 0xFF);
+        return out;
+    }
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "sayo_screen_capture.h"
+#include "sayo_transport.h"
+
+// Report-level helpers shared by the capture code, the simulated device and the
+// trace tools. Everything here is pure byte manipulation, no I/O.
+namespace sayo::detail {
+    constexpr uint8_t kCmdSystemInfo = 0x02;
+    constexpr uint8_t kCmdScreenBuffer = 0x25;
+
+    // Sum of little-endian 16-bit words; this is the "crc" used by HID v2 reports.
+    uint16_t crc16_sum_words_le(const uint8_t* data, size_t len);
+    // Same sum for a piece of a report that starts at byte offset `offset`, added onto crc.
+    uint16_t crc16_accumulate(uint16_t crc, const uint8_t* data, size_t len, size_t offset);
+
+    HidHeader parse_header(const uint8_t* report, size_t reportLen);
+
+    // Recomputes the checksum with the crc field (bytes 2..3) treated as zero.
+    bool verify_crc(const uint8_t* report, size_t reportLen, size_t headerSize);
+    // verify_crc for a report read in pieces (ReadScatter); the first slice must hold the header.
+    bool verify_crc_scattered(const ReadSlice* slices, size_t count, size_t reportLen, size_t headerSize);
+
+    // Hands out echo tags for ProtocolConstants::tagRequests, cycling through every
+    // value except the fixed echoes untagged firmware answers with.
+    uint8_t next_echo_tag();
+
+    // Whether a response echo belongs to a request sent with requestEcho.
+    inline bool echo_matches(const uint8_t echo, const uint8_t requestEcho, const ProtocolConstants& proto) {
+        if (proto.tagRequests) {
+            return echo == requestEcho;
+        }
+        return echo == proto.echo || echo == 0x00 || echo == 0x03 || echo == 0x13;
+    }
+
+    // Rewrites the echo byte of a built report and patches its crc to match.
+    inline void set_report_echo(uint8_t* report, const uint8_t echo) {
+        // byte 1 is the high half of the first crc word
+        const uint16_t crc = static_cast<uint16_t>(report[2] | (static_cast<uint16_t>(report[3]) << 8));
+        const uint16_t fixed = static_cast<uint16_t>(crc + (static_cast<uint8_t>(echo - report[1]) << 8));
+        report[1] = echo;
+        report[2] = static_cast<uint8_t>(fixed & 0xFF);
+        report[3] = static_cast<uint8_t>(fixed >> 8);
+    }
+
+    // One validated CMD 0x25 report; data points into the report it was decoded from.
+    struct ScreenChunk {
+        uint8_t echo = 0;
+        uint8_t index = 0;
+        uint32_t addr = 0;
+        const uint8_t* data = nullptr;
+        size_t len = 0;
+    };
+
+    // Checks report id, cmd, crc and the length field, then splits off the chunk
+    // address. The echo byte is left to the caller.
+    bool decode_screen_chunk(const uint8_t* report, size_t reportLen, const ProtocolConstants& proto,
+                             ScreenChunk& out);
+    // Same, with the word sum of all reportLen bytes (crc field included) already
+    // worked out, e.g. by sum_words_le_batch for a run of reports.
+    bool decode_screen_chunk(const uint8_t* report, size_t reportLen, uint16_t sum, const ProtocolConstants& proto,
+                             ScreenChunk& out);
+
+    // Follows the chunks of one CMD 0x25 response. The firmware walks the frame front
+    // to back and counts HidHeader::index up per chunk, so a chunk that starts past
+    // the expected address, or skips an index, means reports were lost in between.
+    // The index is only trusted once it has been seen counting.
+    struct ChunkSequencer {
+        uint32_t nextAddr = 0;
+        uint8_t nextIndex = 0;
+        uint32_t chunkBytes = 0;
+        bool started = false;
+        bool indexCounts = false;
+
+        // Returns the number of chunks missing right before this one.
+        uint32_t Observe(const ScreenChunk& chunk) {
+            if (!started) {
+                started = true;
+                chunkBytes = static_cast<uint32_t>(chunk.len);
+                nextAddr = 0;
+                nextIndex = 0;
+            }
+            if (chunk.addr < nextAddr) {
+                // repeat or reordered report, nothing is known to be lost
+                return 0;
+            }
+            uint32_t missing = 0;
+            if (chunk.addr > nextAddr && chunkBytes > 0) {
+                missing = (chunk.addr - nextAddr + chunkBytes - 1) / chunkBytes;
+            }
+            if (chunk.addr != 0 && chunk.index == nextIndex) {
+                indexCounts = true;
+            }
+            if (indexCounts) {
+                missing = (std::max)(missing, static_cast<uint32_t>(static_cast<uint8_t>(chunk.index - nextIndex)));
+            }
+            nextAddr = chunk.addr + static_cast<uint32_t>(chunk.len);
+            nextIndex = static_cast<uint8_t>(chunk.index + 1);
+            return missing;
+        }
+    };
+
+    // Read timeout that wakes up right when `quiet` reaches `limit`, so a stalled
+    // stream is noticed on time instead of up to readTimeoutMs late.
+    inline uint32_t quiet_wait_ms(const SteadyClock::duration quiet, const uint32_t readTimeoutMs,
+                                  const SteadyClock::duration limit) {
+        if (quiet >= limit) {
+            return 0;
+        }
+        using Rep = std::chrono::milliseconds::rep;
+        const Rep leftMs = std::chrono::ceil<std::chrono::milliseconds>(limit - quiet).count();
+        return static_cast<uint32_t>((std::min)(static_cast<Rep>(readTimeoutMs), leftMs));
+    }
+
+    std::vector<uint8_t> build_report_v2(
+        uint8_t reportId,
+        uint8_t echo,
+        uint8_t cmd,
+        uint8_t index,
+        const std::vector<uint8_t>& body,
+        size_t headerSize,
+        size_t reportLen);
+
+    // Preference order for the vendor collection to open; lower is better, -1 means unusable.
+    // The report-id 0x22 channel is typically exposed as usage_page=0xFF12 usage=0x02.
+    // the id 0x22 is for high speed mode, 0x21 is used otherwise.
+    // Last resort is any interface-1 collection that is not a standard desktop/consumer page.
+    inline int vendor_collection_rank(const int interfaceNumber, const unsigned short usagePage,
+                                      const unsigned short usage) {
+        if (interfaceNumber != 1) {
+            return -1;
+        }
+        if (usagePage == 0xFF12 && usage == 0x0002) {
+            return 0;
+        }
+        if (usagePage == 0xFF11 && usage == 0x0002) {
+            return 1;
+        }
+        if (usagePage == 0xFF00 && usage == 0x0001) {
+            return 2;
+        }
+        if (usagePage >= 0xFF00) {
+            return 3;
+        }
+        return -1;
+    }
+
+    // Copies len bytes from src across the slices in order; returns bytes copied.
+    inline size_t scatter_copy(const uint8_t* src, size_t len, const ReadSlice* slices, const size_t count) {
+        size_t done = 0;
+        for (size_t i = 0; i < count && done < len; i++) {
+            const size_t n = (slices[i].len < len - done) ? slices[i].len : len - done;
+            std::memcpy(slices[i].data, src + done, n);
+            done += n;
+        }
+        return done;
+    }
+
+    inline uint32_t read_u32_le(const uint8_t* p) {
+        return p[0] | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+            static_cast<uint32_t>(p[3]) << 24;
+    }
+}
@@ -0,0 +1,99 @@
+#include "sayo_reconnect.h"
+
+#include <algorithm>
+
+namespace sayo {
+    namespace {
+        uint32_t elapsed_ms(const SteadyClock::time_point since) {
+            return static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(SteadyClock::now() - since).count());
+        }
+    }
+
+    Reconnector::Reconnector(BringUpBackend& backend, const ReconnectConfig& config)
+        : backend_(backend),
+          config_(config) {
+    }
+
+    std::optional<OpenedDevice> Reconnector::try_open(const OpenHint& last) {
+        if (std::optional<OpenedDevice> opened = backend_.Open(last)) {
+            return opened;
+        }
+        // moved to another port, or came back as a different collection
+        for (const OpenHint& candidate : backend_.Enumerate()) {
+            if (candidate.path == last.path && candidate.usagePage == last.usagePage) {
+                continue;
+            }
+            if (std::optional<OpenedDevice> opened = backend_.Open(candidate)) {
+                return opened;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<OpenedDevice> Reconnector::Reopen(const OpenHint& last) {
+        const auto dropAt = SteadyClock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.drops++;
+            awaitingFrameSince_.reset();
+        }
+
+        auto delay = std::chrono::duration<double, std::milli>(config_.initialDelay);
+        for (uint32_t attempt = 0; config_.maxAttempts == 0 || attempt < config_.maxAttempts; attempt++) {
+            if (attempt > 0) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(delay);
+                if (cv_.wait_for(lock, wait, [&] { return cancelled_; })) {
+                    return std::nullopt;
+                }
+                delay = (std::min)(delay * config_.backoff,
+                                   std::chrono::duration<double, std::milli>(config_.maxDelay));
+            } else {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (cancelled_) {
+                    return std::nullopt;
+                }
+            }
+
+            std::optional<OpenedDevice> opened = try_open(last);
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.attempts++;
+            if (opened) {
+                stats_.reconnects++;
+                stats_.lastReopenMs = elapsed_ms(dropAt);
+                awaitingFrameSince_ = dropAt;
+                return opened;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void Reconnector::Cancel() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    void Reconnector::Reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = false;
+    }
+
+    bool Reconnector::NoteFrame() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!awaitingFrameSince_) {
+            return false;
+        }
+        stats_.lastTimeToFirstFrameMs = elapsed_ms(*awaitingFrameSince_);
+        awaitingFrameSince_.reset();
+        return true;
+    }
+
+    ReconnectStats Reconnector::Stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+#include "sayo_bringup.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    struct ReconnectConfig {
+        // Wait before the second attempt; the first one is immediate.
+        std::chrono::milliseconds initialDelay{20};
+        std::chrono::milliseconds maxDelay{2000};
+        double backoff = 2.0;
+        // Stop after this many attempts; 0 keeps trying until Cancel().
+        uint32_t maxAttempts = 0;
+    };
+
+    struct ReconnectStats {
+        uint64_t drops = 0;
+        uint64_t reconnects = 0;
+        uint64_t attempts = 0;
+        // last reconnect: from the drop to the device being open again
+        uint32_t lastReopenMs = 0;
+        // last reconnect: from the drop to the first frame captured afterwards
+        uint32_t lastTimeToFirstFrameMs = 0;
+    };
+
+    // Gets a dropped device back without restarting anything else. Each attempt opens
+    // the last known collection first, which is all it takes when the device comes
+    // back on the same port, and only enumerates when that fails; the wait between
+    // attempts grows from initialDelay to maxDelay. Callers keep their geometry and
+    // buffers across the outage and only re-query SystemInfo when the reopened device's
+    // key differs from the lost one.
+    class Reconnector {
+    public:
+        explicit Reconnector(BringUpBackend& backend, const ReconnectConfig& config = {});
+
+        // Blocks until a device is open again, Cancel() is called or maxAttempts run out.
+        std::optional<OpenedDevice> Reopen(const OpenHint& last);
+        // Wakes a blocked Reopen(), which then returns nullopt; sticks until Reset().
+        void Cancel();
+        void Reset();
+
+        // Call for every captured frame; true for the first one after a reopen.
+        bool NoteFrame();
+
+        ReconnectStats Stats() const;
+
+    private:
+        std::optional<OpenedDevice> try_open(const OpenHint& last);
+
+        BringUpBackend& backend_;
+        ReconnectConfig config_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        bool cancelled_ = false;
+        ReconnectStats stats_{};
+
+        // drop time of a reconnect still waiting for its first frame
+        std::optional<SteadyClock::time_point> awaitingFrameSince_;
+    };
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace sayo {
+    // Single-producer/single-consumer ring of fixed-size report slots. All storage
+    // is allocated up front; the producer writes straight into a slot and the
+    // consumer reads straight out of it. Push/pop are lock-free; the mutex and
+    // condition variable are only touched when the consumer is parked in WaitForData.
+    class ReportRing {
+    public:
+        // slotCount is rounded up to a power of two.
+        ReportRing(size_t slotCount, size_t slotBytes)
+            : mask_(round_up_pow2(slotCount) - 1),
+              slotBytes_(slotBytes),
+              storage_((mask_ + 1) * slotBytes),
+              lens_(mask_ + 1, 0) {
+        }
+
+        ReportRing(const ReportRing&) = delete;
+        ReportRing& operator=(const ReportRing&) = delete;
+
+        size_t SlotBytes() const {
+            return slotBytes_;
+        }
+        size_t Capacity() const {
+            return mask_ + 1;
+        }
+        size_t Size() const {
+            return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+        }
+
+        // Producer: slot to fill, or nullptr when the ring is full.
+        uint8_t* BeginWrite() {
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) > mask_) {
+                return nullptr;
+            }
+            return storage_.data() + (tail & mask_) * slotBytes_;
+        }
+
+        // Producer: publishes the slot returned by BeginWrite.
+        void CommitWrite(const size_t len) {
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            lens_[tail & mask_] = len;
+            tail_.store(tail + 1, std::memory_order_seq_cst);
+            if (consumerParked_.load(std::memory_order_seq_cst)) {
+                std::lock_guard<std::mutex> lock(parkMutex_);
+                parkCv_.notify_one();
+            }
+        }
+
+        // Consumer: oldest unread slot, or nullptr when empty.
+        const uint8_t* Peek(size_t& len) const {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            len = lens_[head & mask_];
+            return storage_.data() + (head & mask_) * slotBytes_;
+        }
+
+        // Consumer: hands the slot returned by Peek back to the producer.
+        void Release() {
+            head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Consumer: up to maxCount unread slots that lie back to back in storage (a batch
+        // stops at the end of the ring), SlotBytes() apart; lens points at their lengths.
+        // Returns nullptr when empty.
+        const uint8_t* PeekBatch(const size_t maxCount, size_t& count, const size_t*& lens) const {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            const size_t ready = tail_.load(std::memory_order_acquire) - head;
+            const size_t first = head & mask_;
+            count = (std::min)((std::min)(ready, maxCount), mask_ + 1 - first);
+            if (count == 0) {
+                return nullptr;
+            }
+            lens = lens_.data() + first;
+            return storage_.data() + first * slotBytes_;
+        }
+
+        // Consumer: hands back the first count slots of the last PeekBatch.
+        void ReleaseBatch(const size_t count) {
+            head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        // Consumer: blocks until something is readable, the timeout passes or Wake() is called.
+        bool WaitForData(const std::chrono::milliseconds timeout) {
+            if (Size() > 0) {
+                return true;
+            }
+            std::unique_lock<std::mutex> lock(parkMutex_);
+            consumerParked_.store(true, std::memory_order_seq_cst);
+            const bool ready = parkCv_.wait_for(lock, timeout, [&] {
+                return woken_ || tail_.load(std::memory_order_seq_cst) != head_.load(std::memory_order_relaxed);
+            });
+            consumerParked_.store(false, std::memory_order_relaxed);
+            woken_ = false;
+            return ready && Size() > 0;
+        }
+
+        // Producer side: releases a parked consumer without publishing anything (errors, shutdown).
+        void Wake() {
+            std::lock_guard<std::mutex> lock(parkMutex_);
+            woken_ = true;
+            parkCv_.notify_one();
+        }
+
+    private:
+        static size_t round_up_pow2(size_t v) {
+            size_t p = 1;
+            while (p < v) {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        const size_t mask_;
+        const size_t slotBytes_;
+        std::vector<uint8_t> storage_;
+        std::vector<size_t> lens_;
+
+        // kept on separate cache lines so producer and consumer don't false-share
+        alignas(64) std::atomic<size_t> head_{0};
+        alignas(64) std::atomic<size_t> tail_{0};
+
+        alignas(64) std::atomic<bool> consumerParked_{false};
+        std::mutex parkMutex_;
+        std::condition_variable parkCv_;
+        bool woken_ = false;
+    };
+}
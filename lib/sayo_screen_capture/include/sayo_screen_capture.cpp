@@ -1,4 +1,7 @@
 #include "sayo_screen_capture.h"
+#include "sayo_codec.h"
+#include "sayo_protocol.h"
+#include "sayo_timing.h"
 
 #include <algorithm>
 #include <chrono>
@@ -20,6 +23,10 @@
 #include "hidapi.h"
 
 namespace sayo {
+    using detail::echo_matches;
+    using detail::parse_header;
+    using detail::verify_crc_scattered;
+
     namespace {
         std::wstring to_lower_copy(std::wstring s) {
             for (wchar_t& ch : s) {
@@ -51,91 +58,6 @@ namespace sayo {
             return false;
         }
 
-        uint16_t crc16_sum_words_le(const uint8_t* data, const size_t len) {
-            uint16_t crc = 0;
-            for (size_t i = 0; i < len; i++) {
-                uint16_t contribution = data[i];
-                if ((i & 1u) != 0u) {
-                    contribution = static_cast<uint16_t>(contribution << 8);
-                }
-                crc = static_cast<uint16_t>(crc + contribution);
-            }
-            return crc;
-        }
-
-        HidHeader parse_header(const uint8_t* report, const size_t reportLen) {
-            (void)reportLen;
-            HidHeader h{};
-            h.reportId = report[0];
-            h.echo = report[1];
-            h.crc = static_cast<uint16_t>(report[2] | (static_cast<uint16_t>(report[3]) << 8));
-            const uint16_t lenField = static_cast<uint16_t>(report[4] | (static_cast<uint16_t>(report[5]) << 8));
-
-            if ((lenField & 0xFC00u) != 0u) {
-                h.status = static_cast<uint8_t>(lenField >> 10);
-                h.len = static_cast<uint16_t>(lenField & 0x03FFu);
-            } else {
-                h.status = 0;
-                h.len = lenField;
-            }
-            h.cmd = report[6];
-            h.index = report[7];
-            return h;
-        }
-
-        bool verify_crc(const uint8_t* report, const size_t reportLen, const size_t headerSize) {
-            if (reportLen < headerSize) {
-                return false;
-            }
-            const uint16_t packetCrc = static_cast<uint16_t>(report[2] | (static_cast<uint16_t>(report[3]) << 8));
-            uint16_t crc = 0;
-            for (size_t i = 0; i < reportLen; i++) {
-                uint8_t byte = report[i];
-                if (i == 2 || i == 3) {
-                    byte = 0;
-                }
-
-                uint16_t contribution = byte;
-                if ((i & 1u) != 0u) {
-                    contribution = static_cast<uint16_t>(contribution << 8);
-                }
-                crc = static_cast<uint16_t>(crc + contribution);
-            }
-            return packetCrc == crc;
-        }
-
-        std::vector<uint8_t> build_report_v2(
-            const uint8_t reportId,
-            const uint8_t echo,
-            const uint8_t cmd,
-            const uint8_t index,
-            const std::vector<uint8_t>& body,
-            const size_t headerSize,
-            const size_t reportLen) {
-            std::vector<uint8_t> out(reportLen, 0);
-            out[0] = reportId;
-            out[1] = echo;
-            out[2] = 0;
-            out[3] = 0;
-
-            // sayo_api_rs sets header.len to (body_len + 0x04)
-            const uint16_t lenField = static_cast<uint16_t>(body.size() + 0x04);
-            out[4] = static_cast<uint8_t>(lenField & 0xFF);
-            out[5] = static_cast<uint8_t>((lenField >> 8) & 0xFF);
-            out[6] = cmd;
-            out[7] = index;
-
-            for (size_t i = 0; i < body.size() && (headerSize + i) < out.size(); i++) {
-                out[headerSize + i] = body[i];
-            }
-
-            // Compute CRC with crc field set to 0.
-            const uint16_t crc = crc16_sum_words_le(out.data(), out.size());
-            out[2] = static_cast<uint8_t>(crc & 0xFF);
-            out[3] = static_cast<uint8_t>((crc >> 8) & 0xFF);
-            return out;
-        }
-
         void write_u16_le(std::ofstream& f, const uint16_t v) {
             f.put(static_cast<char>(v & 0xFF));
             f.put(static_cast<char>((v >> 8) & 0xFF));
@@ -192,51 +114,24 @@ namespace sayo {
         OpenResult result{};
 
         auto pick_best = [&](hid_device_info* devsList) -> const hid_device_info* {
-            const hid_device_info* best = nullptr;
-
             // IMPORTANT: MI_01 exposes multiple top-level collections.
             // Some of them are keyboard/consumer/etc and will deny WriteFile.
-            // The report-id 0x22 channel is typically exposed as usage_page=0xFF12 usage=0x02.
-            // the id 0x22 is for high speed mode, 0x21 is used otherwise
-            auto find_first = [&](const unsigned short usagePage, const unsigned short usage) -> const hid_device_info*
-            {
-                for (const hid_device_info* it = devsList; it; it = it->next) {
-                    if (it->interface_number != 1) {
-                        continue;
-                    }
-                    if (!matches_device_filters(it, ids)) {
-                        continue;
-                    }
-                    if (it->usage_page == usagePage && it->usage == usage) {
-                        return it;
-                    }
+            // See vendor_collection_rank for the preference order; ties go to the first one listed.
+            const hid_device_info* best = nullptr;
+            int bestRank = -1;
+            for (const hid_device_info* it = devsList; it; it = it->next) {
+                if (!matches_device_filters(it, ids)) {
+                    continue;
                 }
-                return nullptr;
-            };
-
-            best = find_first(0xFF12, 0x0002);
-            if (!best) {
-                best = find_first(0xFF11, 0x0002);
-            }
-            if (!best) {
-                best = find_first(0xFF00, 0x0001);
-            }
-            if (!best) {
-                // last resort: pick the first interface-1 collection that is not a standard desktop/consumer page.
-                for (const hid_device_info* it = devsList; it; it = it->next) {
-                    if (it->interface_number != 1) {
-                        continue;
-                    }
-                    if (!matches_device_filters(it, ids)) {
-                        continue;
-                    }
-                    if (it->usage_page >= 0xFF00) {
-                        best = it;
-                        break;
-                    }
+                const int rank = detail::vendor_collection_rank(it->interface_number, it->usage_page, it->usage);
+                if (rank < 0) {
+                    continue;
+                }
+                if (!best || rank < bestRank) {
+                    best = it;
+                    bestRank = rank;
                 }
             }
-
             return best;
         };
 
@@ -271,23 +166,39 @@ namespace sayo {
         return result;
     }
 
-    std::optional<std::pair<uint16_t, uint16_t>> TryGetLcdSize(hid_device* dev, const ProtocolConstants& proto) {
+    bool DecodeSystemInfo(const uint8_t* payload, const size_t payloadLen, SystemInfo& out) {
+        if (payloadLen < 4) {
+            return false;
+        }
+        out = {};
+        out.lcdW = static_cast<uint16_t>(payload[0] | (static_cast<uint16_t>(payload[1]) << 8));
+        out.lcdH = static_cast<uint16_t>(payload[2] | (static_cast<uint16_t>(payload[3]) << 8));
+        if (payloadLen >= 5) {
+            out.refreshRate = payload[4];
+        }
+        return true;
+    }
+
+    std::optional<SystemInfo> TryGetSystemInfo(hid_device* dev, const ProtocolConstants& proto) {
+        HidapiTransport transport(dev);
+        return TryGetSystemInfo(transport, proto);
+    }
+
+    std::optional<SystemInfo> TryGetSystemInfo(Transport& transport, const ProtocolConstants& proto) {
         // Request SystemInfo (CMD 0x02), index 0, empty body.
-        const std::vector<uint8_t> out = build_report_v2(proto.reportId22, proto.echo, proto.cmdSystemInfo, 0x00, {},
-                                                         proto.headerSize, proto.reportLen22);
-        const int response = hid_write(dev, out.data(), static_cast<int>(out.size()));
+        const uint8_t echo = proto.tagRequests ? detail::next_echo_tag() : proto.echo;
+        const ReportVariant variant = SelectReportVariant(proto);
+        detail::RequestReport out(proto, proto.cmdSystemInfo);
+        out.SetEcho(echo);
+        const int response = transport.Write(out.Data(), out.Size());
         if (response < 0) {
             return std::nullopt;
         }
 
         std::vector<uint8_t> in(proto.reportLen22, 0);
-        const auto echo_ok = [&](const uint8_t echo) {
-            return echo == proto.echo || echo == 0x00 || echo == 0x03 || echo == 0x13;
-        };
-        const auto start = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(proto.commandTimeoutMs)) {
-            const int r = hid_read_timeout(dev, in.data(), static_cast<int>(in.size()),
-                                           static_cast<int>(proto.readTimeoutMs));
+        const auto start = transport.Now();
+        while (transport.Now() - start < std::chrono::milliseconds(proto.commandTimeoutMs)) {
+            const int r = transport.ReadTimeout(in.data(), in.size(), static_cast<int>(proto.readTimeoutMs));
             if (r <= 0) {
                 continue;
             }
@@ -299,10 +210,10 @@ namespace sayo {
             if (h.reportId != proto.reportId22) {
                 continue;
             }
-            if (!echo_ok(h.echo)) {
+            if (!echo_matches(h.echo, echo, proto)) {
                 continue;
             }
-            if (!verify_crc(in.data(), static_cast<size_t>(r), proto.headerSize)) {
+            if (!detail::verify_crc(variant, in.data(), static_cast<size_t>(r), proto.headerSize)) {
                 continue;
             }
             if (h.cmd != proto.cmdSystemInfo) {
@@ -313,70 +224,40 @@ namespace sayo {
             if (dataEnd <= proto.headerSize || dataEnd > in.size()) {
                 continue;
             }
-            const size_t payloadLen = dataEnd - proto.headerSize;
-            if (payloadLen < 4) {
+            SystemInfo info;
+            if (!DecodeSystemInfo(in.data() + proto.headerSize, dataEnd - proto.headerSize, info)) {
                 continue;
             }
-            const uint8_t* payload = in.data() + proto.headerSize;
-            const uint16_t w = static_cast<uint16_t>(payload[0] | (static_cast<uint16_t>(payload[1]) << 8));
-            const uint16_t hgt = static_cast<uint16_t>(payload[2] | (static_cast<uint16_t>(payload[3]) << 8));
-            return std::make_pair(w, hgt);
+            return info;
         }
 
         return std::nullopt;
     }
 
-    std::optional<std::uint8_t> TryGetRefreshRate(hid_device* dev, const ProtocolConstants& proto) {
-        // Request SystemInfo (CMD 0x02), index 0, empty body.
-        const std::vector<uint8_t> out = build_report_v2(proto.reportId22, proto.echo, proto.cmdSystemInfo, 0x00, {},
-                                                         proto.headerSize, proto.reportLen22);
-        const int response = hid_write(dev, out.data(), static_cast<int>(out.size()));
-        if (response < 0) {
+    std::optional<std::pair<uint16_t, uint16_t>> TryGetLcdSize(hid_device* dev, const ProtocolConstants& proto) {
+        HidapiTransport transport(dev);
+        return TryGetLcdSize(transport, proto);
+    }
+
+    std::optional<std::pair<uint16_t, uint16_t>> TryGetLcdSize(Transport& transport, const ProtocolConstants& proto) {
+        const std::optional<SystemInfo> info = TryGetSystemInfo(transport, proto);
+        if (!info) {
             return std::nullopt;
         }
+        return std::make_pair(info->lcdW, info->lcdH);
+    }
 
-        std::vector<uint8_t> in(proto.reportLen22, 0);
-        const auto echo_ok = [&](const uint8_t echo) {
-            return echo == proto.echo || echo == 0x00 || echo == 0x03 || echo == 0x13;
-        };
-        const auto start = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(proto.commandTimeoutMs)) {
-            const int r = hid_read_timeout(dev, in.data(), static_cast<int>(in.size()),
-                static_cast<int>(proto.readTimeoutMs));
-            if (r <= 0) {
-                continue;
-            }
-            if (static_cast<size_t>(r) < proto.headerSize) {
-                continue;
-            }
-
-            const HidHeader h = parse_header(in.data(), static_cast<size_t>(r));
-            if (h.reportId != proto.reportId22) {
-                continue;
-            }
-            if (!echo_ok(h.echo)) {
-                continue;
-            }
-            if (!verify_crc(in.data(), static_cast<size_t>(r), proto.headerSize)) {
-                continue;
-            }
-            if (h.cmd != proto.cmdSystemInfo) {
-                continue;
-            }
+    std::optional<std::uint8_t> TryGetRefreshRate(hid_device* dev, const ProtocolConstants& proto) {
+        HidapiTransport transport(dev);
+        return TryGetRefreshRate(transport, proto);
+    }
 
-            const size_t dataEnd = static_cast<size_t>(h.len) + 4;
-            if (dataEnd <= proto.headerSize || dataEnd > in.size()) {
-                continue;
-            }
-            const size_t payloadLen = dataEnd - proto.headerSize;
-            if (payloadLen < 5) {
-                continue;
-            }
-            const uint8_t* payload = in.data() + proto.headerSize;
-            return payload[4];
+    std::optional<std::uint8_t> TryGetRefreshRate(Transport& transport, const ProtocolConstants& proto) {
+        const std::optional<SystemInfo> info = TryGetSystemInfo(transport, proto);
+        if (!info) {
+            return std::nullopt;
         }
-
-        return std::nullopt;
+        return info->refreshRate;
     }
 
     CaptureFrameResult CaptureScreenFrame(
@@ -386,7 +267,21 @@ namespace sayo {
         std::vector<uint8_t>& scratchIn,
         std::vector<uint8_t>& outRgb565,
         CaptureStats* stats,
-        const ProtocolConstants& proto) {
+        const ProtocolConstants& proto,
+        const CaptureOptions& options) {
+        HidapiTransport transport(handle);
+        return CaptureScreenFrame(transport, lcdW, lcdH, scratchIn, outRgb565, stats, proto, options);
+    }
+
+    CaptureFrameResult CaptureScreenFrame(
+        Transport& transport,
+        const uint16_t lcdW,
+        const uint16_t lcdH,
+        std::vector<uint8_t>& scratchIn,
+        std::vector<uint8_t>& outRgb565,
+        CaptureStats* stats,
+        const ProtocolConstants& proto,
+        const CaptureOptions& options) {
         const size_t expectedFrameBytes = static_cast<size_t>(lcdW) * static_cast<size_t>(lcdH) * 2;
         if (lcdW == 0 || lcdH == 0) {
             return CaptureFrameResult::NoData;
@@ -399,33 +294,136 @@ namespace sayo {
         }
 
         if (stats) {
-            stats->packets = 0;
-            stats->bytesCovered = 0;
-            stats->durationMs = 0;
+            *stats = CaptureStats{};
         }
 
-        const std::vector<uint8_t> req = build_report_v2(proto.reportId22, proto.echo, proto.cmdScreenBuffer, 0x00, {},
-                                                         proto.headerSize, proto.reportLen22);
-        const auto t0 = std::chrono::steady_clock::now();
-        const int response = hid_write(handle, req.data(), static_cast<int>(req.size()));
-        if (response < 0) {
+        // Zero-copy: header + chunk address go to scratchIn, the pixels are read straight
+        // into outRgb565 at the address the next chunk is predicted to carry, and any
+        // report bytes past the frame end go to the rest of scratchIn. They land before
+        // the report is checked, so whatever didn't end up covered is put back from
+        // concealFrom; without it, reports are copied in only once they are valid.
+        const size_t prefixLen = proto.headerSize + 4;
+        const std::vector<uint8_t>* restoreFrom =
+            options.concealFrom && options.concealFrom->size() == expectedFrameBytes ? options.concealFrom : nullptr;
+        const bool scatter = options.zeroCopy && restoreFrom && proto.reportLen22 > prefixLen;
+        size_t predicted = 0;
+        // bytes of outRgb565 the last scattered read wrote to
+        size_t clobberedBegin = 0;
+        size_t clobberedEnd = 0;
+
+        thread_local CoverageMap localCoverage;
+        CoverageMap& coverage = options.coverage ? *options.coverage : localCoverage;
+        coverage.Reset(expectedFrameBytes);
+
+        const ReportVariant variant = SelectReportVariant(proto);
+        detail::RequestReport req(proto, proto.cmdScreenBuffer);
+        uint8_t echo = proto.echo;
+        SteadyClock::time_point requestAt{};
+        const auto send_request = [&] {
+            if (proto.tagRequests) {
+                echo = detail::next_echo_tag();
+                req.SetEcho(echo);
+            }
+            requestAt = transport.Now();
+            return transport.Write(req.Data(), req.Size()) >= 0;
+        };
+
+        const SteadyClock::duration idleBreak = options.timing
+            ? options.timing->IdleBreak(proto)
+            : std::chrono::milliseconds(proto.idleBreakMs);
+        const SteadyClock::duration firstChunkTimeout = options.timing
+            ? options.timing->FirstChunkTimeout(proto)
+            : std::chrono::milliseconds(proto.commandTimeoutMs);
+
+        const auto restore_clobbered = [&] {
+            size_t holeBegin = 0;
+            size_t holeEnd = clobberedBegin;
+            while (coverage.NextMissing(holeEnd, clobberedEnd, holeBegin, holeEnd)) {
+                std::memcpy(outRgb565.data() + holeBegin, restoreFrom->data() + holeBegin, holeEnd - holeBegin);
+            }
+            clobberedBegin = clobberedEnd = 0;
+        };
+
+        const auto t0 = transport.Now();
+        if (!send_request()) {
             return CaptureFrameResult::DeviceError;
         }
 
         size_t maxEnd = 0;
-        auto lastChunk = std::chrono::steady_clock::now();
-        const auto echo_ok = [&](const uint8_t echo) {
-            return echo == proto.echo || echo == 0x00 || echo == 0x03 || echo == 0x13;
+        auto lastChunk = transport.Now();
+        detail::ChunkSequencer sequence;
+        uint32_t retriesLeft = options.maxGapRetries;
+        // a retry's first chunk may queue behind the rest of the broken response
+        bool firstRequest = true;
+        const auto retry = [&] {
+            retriesLeft--;
+            firstRequest = false;
+            if (stats) {
+                stats->retries++;
+            }
+            // keep what arrived so far, the retry only has to fill the holes
+            maxEnd = 0;
+            predicted = 0;
+            sequence = {};
+            return send_request();
         };
-        while (std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(proto.commandTimeoutMs)) {
-            const int response = hid_read_timeout(handle, scratchIn.data(), static_cast<int>(scratchIn.size()),
-                                                  static_cast<int>(proto.readTimeoutMs));
+
+        while (transport.Now() - t0 < std::chrono::milliseconds(proto.commandTimeoutMs)) {
+            // a rejected report, the slot a missed prediction moved out of, padding past a short chunk
+            restore_clobbered();
+            // once chunks are flowing, silence longer than idleBreak means the rest was lost
+            const uint32_t waitMs = sequence.started
+                ? detail::quiet_wait_ms(transport.Now() - lastChunk, proto.readTimeoutMs, idleBreak)
+                : detail::quiet_wait_ms(transport.Now() - requestAt, proto.readTimeoutMs, firstChunkTimeout);
+            int response = 0;
+            size_t landed = 0;
+            ReadSlice slices[3];
+            size_t sliceCount = 0;
+            if (scatter && predicted < expectedFrameBytes) {
+                landed = (std::min)(proto.reportLen22 - prefixLen, expectedFrameBytes - predicted);
+            }
+            // only land in place where nothing has arrived yet; a miss overwrites the slot
+            if (landed > 0 && !coverage.Any(predicted, predicted + landed)) {
+                slices[0] = {scratchIn.data(), prefixLen};
+                slices[1] = {outRgb565.data() + predicted, landed};
+                slices[2] = {scratchIn.data() + prefixLen, proto.reportLen22 - prefixLen - landed};
+                sliceCount = slices[2].len > 0 ? 3 : 2;
+                response = transport.ReadScatter(slices, sliceCount, static_cast<int>(waitMs));
+                clobberedBegin = predicted;
+                clobberedEnd = predicted + landed;
+            } else {
+                response = transport.ReadTimeout(scratchIn.data(), scratchIn.size(), static_cast<int>(waitMs));
+            }
             if (response < 0) {
                 return CaptureFrameResult::DeviceError;
             }
             if (response == 0) {
-                if (maxEnd >= expectedFrameBytes && (std::chrono::steady_clock::now() - lastChunk) >
-                    std::chrono::milliseconds(proto.idleBreakMs)) {
+                if (!sequence.started && transport.Now() - requestAt >= firstChunkTimeout) {
+                    // far past this device's usual response time, the request got lost
+                    if (retriesLeft > 0) {
+                        if (!retry()) {
+                            return CaptureFrameResult::DeviceError;
+                        }
+                        continue;
+                    }
+                    break;
+                }
+                if (sequence.started && transport.Now() - lastChunk >= idleBreak) {
+                    if (maxEnd < expectedFrameBytes && !coverage.Full()) {
+                        // lost tail, don't sit out commandTimeoutMs for it
+                        if (stats) {
+                            stats->gaps++;
+                        }
+                        if (options.timing) {
+                            options.timing->ObserveSilence(transport.Now() - lastChunk);
+                        }
+                        if (retriesLeft > 0) {
+                            if (!retry()) {
+                                return CaptureFrameResult::DeviceError;
+                            }
+                            continue;
+                        }
+                    }
                     break;
                 }
                 continue;
@@ -436,13 +434,21 @@ namespace sayo {
             if (scratchIn[0] != proto.reportId22) {
                 continue;
             }
-            if (!echo_ok(scratchIn[1])) {
+            if (scratchIn[6] != proto.cmdScreenBuffer) {
                 continue;
             }
-            if (scratchIn[6] != proto.cmdScreenBuffer) {
+            if (!echo_matches(scratchIn[1], echo, proto)) {
+                if (stats && proto.tagRequests) {
+                    stats->staleReports++;
+                }
                 continue;
             }
-            if (!verify_crc(scratchIn.data(), static_cast<size_t>(response), proto.headerSize)) {
+            if (sliceCount > 0) {
+                if (!verify_crc_scattered(slices, sliceCount, static_cast<size_t>(response), proto.headerSize)) {
+                    continue;
+                }
+            } else if (!detail::verify_crc(variant, scratchIn.data(), static_cast<size_t>(response),
+                                           proto.headerSize)) {
                 continue;
             }
 
@@ -460,30 +466,109 @@ namespace sayo {
                 continue;
             }
             const uint8_t* payload = scratchIn.data() + proto.headerSize;
-            const uint32_t addr = payload[0] | static_cast<uint32_t>(payload[1]) << 8 |
-                static_cast<uint32_t>(payload[2]) << 16 | static_cast<uint32_t>(payload[3]) << 24;
+            const uint32_t addr = detail::read_u32_le(payload);
             const size_t bytesLen = payloadLen - 4;
             if (bytesLen == 0) {
                 continue;
             }
             const size_t end = static_cast<size_t>(addr) + bytesLen;
-            if (end <= outRgb565.size()) {
+            if (sliceCount > 0) {
+                if (addr == predicted) {
+                    // already in place
+                    if (stats) {
+                        stats->zeroCopyHits++;
+                    }
+                } else {
+                    // Prediction missed: the pixels sit at `predicted` (and in scratchIn for
+                    // whatever didn't fit), move them to where they belong. The clobbered
+                    // bytes at `predicted` are past everything received so far.
+                    if (stats) {
+                        stats->zeroCopyMisses++;
+                    }
+                    if (end <= outRgb565.size()) {
+                        const size_t inFrame = (std::min)(bytesLen, landed);
+                        std::memmove(outRgb565.data() + addr, outRgb565.data() + predicted, inFrame);
+                        if (bytesLen > inFrame) {
+                            std::memcpy(outRgb565.data() + addr + inFrame, scratchIn.data() + prefixLen,
+                                        bytesLen - inFrame);
+                        }
+                    }
+                }
+                predicted = end;
+            } else if (end <= outRgb565.size()) {
                 std::memcpy(outRgb565.data() + addr, payload + 4, bytesLen);
             }
-            maxEnd = (std::max)(maxEnd, end);
-            lastChunk = std::chrono::steady_clock::now();
+            const auto arrived = transport.Now();
+            if (stats && coverage.Covered() == 0) {
+                stats->firstChunkUs = static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(arrived - t0).count());
+            }
+            detail::ScreenChunk chunk{};
+            chunk.index = h.index;
+            chunk.addr = addr;
+            chunk.len = bytesLen;
+            const bool firstChunk = !sequence.started;
+            const uint32_t missing = sequence.Observe(chunk);
+            if (options.timing) {
+                if (firstChunk && firstRequest) {
+                    options.timing->ObserveFirstChunk(arrived - requestAt);
+                } else if (!firstChunk && missing == 0) {
+                    options.timing->ObserveInterArrival(arrived - lastChunk);
+                }
+            }
+
+            // a chunk reaching past the frame was not copied: nothing of it arrived
+            if (end <= outRgb565.size()) {
+                maxEnd = (std::max)(maxEnd, end);
+                coverage.Mark(addr, end);
+            }
+            lastChunk = arrived;
+            // A retry can complete the frame midway through its response. Untagged, the
+            // rest of that response must still be drained or the next capture takes it.
+            if (coverage.Full() && (proto.tagRequests || maxEnd >= expectedFrameBytes)) {
+                break;
+            }
+
+            if (missing > 0) {
+                if (stats) {
+                    stats->gaps += missing;
+                }
+                // With tagged requests whatever is left of this response gets dropped as
+                // stale, so re-request right away. Untagged, its remaining chunks would be
+                // taken for the retry's, so the retry waits until it has finished.
+                if (proto.tagRequests && retriesLeft > 0) {
+                    if (!retry()) {
+                        return CaptureFrameResult::DeviceError;
+                    }
+                    continue;
+                }
+            }
             if (maxEnd >= expectedFrameBytes) {
+                // end of the response, but with holes
+                if (retriesLeft > 0) {
+                    if (!retry()) {
+                        return CaptureFrameResult::DeviceError;
+                    }
+                    continue;
+                }
                 break;
             }
         }
 
+        restore_clobbered();
+        const size_t covered = coverage.Covered();
+        size_t concealed = 0;
+        if (options.concealFrom && covered > 0) {
+            concealed = ConcealMissing(outRgb565, coverage, *options.concealFrom);
+        }
         if (stats) {
-            stats->bytesCovered = static_cast<uint32_t>((std::min)(maxEnd, expectedFrameBytes));
+            stats->bytesCovered = static_cast<uint32_t>(covered);
+            stats->bytesConcealed = static_cast<uint32_t>(concealed);
             stats->durationMs = static_cast<uint32_t>(
-                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count());
+                std::chrono::duration_cast<std::chrono::milliseconds>(transport.Now() - t0).count());
         }
 
-        return (maxEnd > 0) ? CaptureFrameResult::Ok : CaptureFrameResult::NoData;
+        return (covered > 0) ? CaptureFrameResult::Ok : CaptureFrameResult::NoData;
     }
 
 #if _DEBUG
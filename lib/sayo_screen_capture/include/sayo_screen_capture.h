@@ -7,10 +7,15 @@
 #include <utility>
 #include <vector>
 
+#include "sayo_coverage.h"
+#include "sayo_transport.h"
+
 struct hid_device;
 struct hid_device_info;
 
 namespace sayo {
+    class AdaptiveTiming;
+
     struct HidHeader {
         uint8_t reportId{};
         uint8_t echo{};
@@ -23,8 +28,45 @@ namespace sayo {
 
     struct CaptureStats {
         uint32_t packets = 0;
+        // bytes that actually arrived (holes don't count)
         uint32_t bytesCovered = 0;
+        // CaptureOptions::concealFrom only: bytes filled in from it
+        uint32_t bytesConcealed = 0;
         uint32_t durationMs = 0;
+        // from the first request to the first chunk that landed; 0 when none did
+        uint32_t firstChunkUs = 0;
+        // CaptureOptions::zeroCopy only: chunks that landed at the predicted address vs. had to be moved.
+        uint32_t zeroCopyHits = 0;
+        uint32_t zeroCopyMisses = 0;
+        // ProtocolConstants::tagRequests only: valid reports answering some other (earlier) request.
+        uint32_t staleReports = 0;
+        // chunks found missing (index/address skips, or a lost tail) and frames re-requested because of it
+        uint32_t gaps = 0;
+        uint32_t retries = 0;
+    };
+
+    struct CaptureOptions {
+        // Read CMD 0x25 payloads directly into outRgb565 at the address predicted from the
+        // previous chunk, instead of into scratchIn followed by a memcpy. Falls back to a
+        // copy when the prediction misses. Best with transports that implement
+        // ReadScatter natively (HidrawTransport, PipelinedReader). Needs concealFrom (same
+        // size as the frame): pixels land before their report is checked, and whatever a
+        // rejected report overwrote is put back from it. Without it reports are copied.
+        bool zeroCopy = false;
+        // How often a frame is re-requested once a chunk is known to be lost, instead of
+        // returning it with a hole. With ProtocolConstants::tagRequests a gap in the
+        // middle re-requests immediately, otherwise once the broken response is over.
+        // Off by default: on lossy 64-byte links nearly every retry has a gap of its own.
+        // (A lost tail is always noticed after idleBreakMs of silence, not commandTimeoutMs.)
+        uint32_t maxGapRetries = 0;
+        // Learned per-device timing (see sayo_timing.h) replacing idleBreakMs and most of
+        // commandTimeoutMs for the first chunk; updated by every capture. Optional.
+        AdaptiveTiming* timing = nullptr;
+        // Receives exactly which bytes of outRgb565 arrived. Optional.
+        CoverageMap* coverage = nullptr;
+        // Ranges that didn't arrive are copied from here, usually the last frame shown.
+        // Without it they keep whatever outRgb565 held before.
+        const std::vector<uint8_t>* concealFrom = nullptr;
     };
 
     enum class CaptureFrameResult : uint8_t {
@@ -52,6 +94,11 @@ namespace sayo {
         uint32_t readTimeoutMs = 50;
         uint32_t commandTimeoutMs = 1500;
         uint32_t idleBreakMs = 10;
+        // Give every request its own echo value (instead of `echo`) and accept only
+        // responses that carry it back, so late reports of a timed-out request can't
+        // land in the next one. Only for firmware that echoes the request's echo byte
+        // verbatim; the default accepts the fixed values seen in the wild (0x00/0x03/0x13).
+        bool tagRequests = false;
     };
 
     struct OpenResult {
@@ -62,6 +109,12 @@ namespace sayo {
         int interfaceNumber = -1;
     };
 
+    // Where the vendor collection was found last time; persist it between runs.
+    struct OpenHint {
+        std::string path;
+        unsigned short usagePage = 0;
+    };
+
     enum class OutputStream {
         StdErr,
         StdOut
@@ -74,18 +127,46 @@ namespace sayo {
     // On O3C, this is typically usage_page=0xFF12 (report 0x22) or 0xFF11 (report 0x21).
     OpenResult OpenVendorInterface(const DeviceIds& ids, OutputStream output);
 
+    // Everything a SystemInfo (CMD 0x02) response carries that sayomirror uses.
+    struct SystemInfo {
+        uint16_t lcdW = 0;
+        uint16_t lcdH = 0;
+        // payload byte 4; firmware with a shorter payload leaves it out
+        std::optional<uint8_t> refreshRate;
+    };
+
+    // Decodes a SystemInfo payload (the bytes after the header). False when it is too
+    // short to carry the LCD size.
+    bool DecodeSystemInfo(const uint8_t* payload, size_t payloadLen, SystemInfo& out);
+
+    // One SystemInfo (CMD 0x02) round trip, every field decoded. Returns nullopt on timeout.
+    std::optional<SystemInfo> TryGetSystemInfo(
+        hid_device* dev,
+        const ProtocolConstants& proto = {});
+    std::optional<SystemInfo> TryGetSystemInfo(
+        Transport& transport,
+        const ProtocolConstants& proto = {});
+
     // Queries LCD size via SystemInfo (CMD 0x02). Returns nullopt on timeout.
+    // Prefer TryGetSystemInfo when the refresh rate is needed too.
     std::optional<std::pair<uint16_t, uint16_t>> TryGetLcdSize(
         hid_device* dev,
         const ProtocolConstants& proto = {});
+    std::optional<std::pair<uint16_t, uint16_t>> TryGetLcdSize(
+        Transport& transport,
+        const ProtocolConstants& proto = {});
 
     // Queries LCD refresh rate via SystemInfo (CMD 0x02). Returns nullopt on timeout.
     std::optional<std::uint8_t> TryGetRefreshRate(
         hid_device* dev,
         const ProtocolConstants& proto = {});
+    std::optional<std::uint8_t> TryGetRefreshRate(
+        Transport& transport,
+        const ProtocolConstants& proto = {});
 
     // Captures the screen buffer into RGB565 (little-endian, 2 bytes/pixel).
-    // outRgb565 will be resized to width * height * 2.
+    // outRgb565 will be resized to width * height * 2; when it already has that size it
+    // is not cleared, so pass the same buffers back in rather than empty ones.
     CaptureFrameResult CaptureScreenFrame(
         hid_device* handle,
         uint16_t lcdW,
@@ -93,7 +174,17 @@ namespace sayo {
         std::vector<uint8_t>& scratchIn,
         std::vector<uint8_t>& outRgb565,
         CaptureStats* stats = nullptr,
-        const ProtocolConstants& proto = {});
+        const ProtocolConstants& proto = {},
+        const CaptureOptions& options = {});
+    CaptureFrameResult CaptureScreenFrame(
+        Transport& transport,
+        uint16_t lcdW,
+        uint16_t lcdH,
+        std::vector<uint8_t>& scratchIn,
+        std::vector<uint8_t>& outRgb565,
+        CaptureStats* stats = nullptr,
+        const ProtocolConstants& proto = {},
+        const CaptureOptions& options = {});
 
     // Writes raw RGB565 bytes to a file, exactly width * height * 2 bytes.
     bool WriteRgb565BinFile(
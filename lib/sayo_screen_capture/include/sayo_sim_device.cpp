@@ -0,0 +1,217 @@
+#include "sayo_sim_device.h"
+#include "sayo_protocol.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace sayo {
+    namespace {
+        constexpr size_t kSystemInfoPayloadBytes = 8;
+
+        void default_frame_generator(const uint64_t frameIndex, std::vector<uint8_t>& rgb565) {
+            // moving diagonal gradient, so consecutive frames never compare equal
+            const auto shift = static_cast<uint16_t>(frameIndex * 7u);
+            for (size_t i = 0; i + 1 < rgb565.size(); i += 2) {
+                const auto v = static_cast<uint16_t>((i / 2) + shift);
+                rgb565[i] = static_cast<uint8_t>(v & 0xFF);
+                rgb565[i + 1] = static_cast<uint8_t>(v >> 8);
+            }
+        }
+    }
+
+    SimulatedDevice::SimulatedDevice(const SimulatedDeviceConfig& config)
+        : config_(config),
+          frame_(static_cast<size_t>(config.lcdW) * static_cast<size_t>(config.lcdH) * 2, 0),
+          generator_(default_frame_generator),
+          rng_(config.seed) {
+    }
+
+    SteadyClock::time_point SimulatedDevice::Now() const {
+        return config_.clock ? config_.clock->Now() : SteadyClock::now();
+    }
+
+    void SimulatedDevice::SetFrameGenerator(FrameGenerator generator) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generator_ = generator ? std::move(generator) : FrameGenerator(default_frame_generator);
+    }
+
+    void SimulatedDevice::Disconnect() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        disconnected_ = true;
+        cv_.notify_all();
+    }
+
+    SimulatedDeviceCounters SimulatedDevice::Counters() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return counters_;
+    }
+
+    size_t SimulatedDevice::ChunkPayloadBytes() const {
+        // header, then a 4-byte little-endian frame address, then pixels
+        if (config_.reportLen <= config_.headerSize + 4) {
+            return 0;
+        }
+        return config_.reportLen - config_.headerSize - 4;
+    }
+
+    int SimulatedDevice::Write(const uint8_t* data, const size_t len) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (disconnected_ || !data || len < config_.headerSize || data[0] != config_.reportId) {
+            return -1;
+        }
+        counters_.requests++;
+
+        const HidHeader h = detail::parse_header(data, len);
+        if (!detail::verify_crc(data, len, config_.headerSize)) {
+            counters_.rejectedRequests++;
+            return static_cast<int>(len);
+        }
+
+        Job job{};
+        job.echo = h.echo;
+        job.cmd = h.cmd;
+        job.readyAt = Now() + std::chrono::microseconds(config_.responseLatencyUs);
+        if (h.cmd == detail::kCmdSystemInfo) {
+            job.chunkCount = 1;
+        } else if (h.cmd == detail::kCmdScreenBuffer && !frame_.empty() && ChunkPayloadBytes() > 0) {
+            generator_(frameIndex_++, frame_);
+            job.frame = frame_;
+            job.chunkCount = static_cast<uint32_t>((frame_.size() + ChunkPayloadBytes() - 1) / ChunkPayloadBytes());
+        } else {
+            counters_.rejectedRequests++;
+            return static_cast<int>(len);
+        }
+
+        jobs_.push_back(std::move(job));
+        cv_.notify_all();
+        return static_cast<int>(len);
+    }
+
+    int SimulatedDevice::ReadTimeout(uint8_t* data, const size_t len, const int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const auto deadline = Now() + std::chrono::milliseconds((std::max)(timeoutMs, 0));
+        for (;;) {
+            if (disconnected_) {
+                return -1;
+            }
+            const auto now = Now();
+            if (!jobs_.empty()) {
+                const auto due = next_due_locked();
+                if (due <= now) {
+                    const size_t n = emit_report_locked(data, len);
+                    if (n > 0) {
+                        return static_cast<int>(n);
+                    }
+                    continue;
+                }
+                if (due <= deadline) {
+                    wait_until(lock, due);
+                    continue;
+                }
+            }
+            if (now >= deadline) {
+                if (timeoutMs <= 0 && config_.clock) {
+                    // a non-blocking poll still costs a little time, otherwise
+                    // spin loops would never make progress in virtual time
+                    config_.clock->Advance(std::chrono::microseconds(1));
+                }
+                return 0;
+            }
+            wait_until(lock, deadline);
+        }
+    }
+
+    SteadyClock::time_point SimulatedDevice::next_due_locked() {
+        if (nextDueValid_) {
+            return nextReportDue_;
+        }
+        const Job& job = jobs_.front();
+        auto due = lastReportAt_ + std::chrono::microseconds(config_.reportIntervalUs);
+        if (job.nextChunk == 0) {
+            due = (std::max)(due, job.readyAt);
+        }
+        if (config_.jitterUs > 0) {
+            std::uniform_int_distribution<uint32_t> jitter(0, config_.jitterUs);
+            due += std::chrono::microseconds(jitter(rng_));
+        }
+        nextReportDue_ = due;
+        nextDueValid_ = true;
+        return due;
+    }
+
+    size_t SimulatedDevice::emit_report_locked(uint8_t* data, const size_t len) {
+        Job& job = jobs_.front();
+        lastReportAt_ = nextReportDue_;
+        nextDueValid_ = false;
+
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        const bool drop = config_.dropRate > 0.0 && unit(rng_) < config_.dropRate;
+        const bool corrupt = config_.corruptCrcRate > 0.0 && unit(rng_) < config_.corruptCrcRate;
+
+        report_.assign(config_.reportLen, 0);
+        size_t payloadLen = 0;
+        uint8_t* payload = report_.data() + config_.headerSize;
+        if (job.cmd == detail::kCmdSystemInfo) {
+            payloadLen = kSystemInfoPayloadBytes;
+            payload[0] = static_cast<uint8_t>(config_.lcdW & 0xFF);
+            payload[1] = static_cast<uint8_t>(config_.lcdW >> 8);
+            payload[2] = static_cast<uint8_t>(config_.lcdH & 0xFF);
+            payload[3] = static_cast<uint8_t>(config_.lcdH >> 8);
+            payload[4] = config_.refreshRate;
+        } else {
+            const size_t chunk = ChunkPayloadBytes();
+            const size_t addr = static_cast<size_t>(job.nextChunk) * chunk;
+            const size_t n = (std::min)(chunk, job.frame.size() - addr);
+            payload[0] = static_cast<uint8_t>(addr & 0xFF);
+            payload[1] = static_cast<uint8_t>((addr >> 8) & 0xFF);
+            payload[2] = static_cast<uint8_t>((addr >> 16) & 0xFF);
+            payload[3] = static_cast<uint8_t>((addr >> 24) & 0xFF);
+            std::memcpy(payload + 4, job.frame.data() + addr, n);
+            payloadLen = 4 + n;
+        }
+
+        // the decoder computes dataEnd as len + 4
+        const auto lenField = static_cast<uint16_t>(config_.headerSize + payloadLen - 4);
+        report_[0] = config_.reportId;
+        report_[1] = job.echo;
+        report_[4] = static_cast<uint8_t>(lenField & 0xFF);
+        report_[5] = static_cast<uint8_t>(lenField >> 8);
+        report_[6] = job.cmd;
+        report_[7] = static_cast<uint8_t>(job.nextChunk & 0xFF);
+        uint16_t crc = detail::crc16_sum_words_le(report_.data(), report_.size());
+        if (corrupt) {
+            crc = static_cast<uint16_t>(crc ^ 0xA5A5u);
+        }
+        report_[2] = static_cast<uint8_t>(crc & 0xFF);
+        report_[3] = static_cast<uint8_t>(crc >> 8);
+
+        job.nextChunk++;
+        if (job.nextChunk >= job.chunkCount) {
+            if (job.cmd == detail::kCmdScreenBuffer) {
+                counters_.framesServed++;
+            }
+            jobs_.pop_front();
+        }
+
+        if (drop) {
+            counters_.reportsDropped++;
+            return 0;
+        }
+        if (corrupt) {
+            counters_.reportsCorrupted++;
+        }
+        counters_.reportsSent++;
+        const size_t n = (std::min)(len, report_.size());
+        std::memcpy(data, report_.data(), n);
+        return n;
+    }
+
+    void SimulatedDevice::wait_until(std::unique_lock<std::mutex>& lock, const SteadyClock::time_point t) {
+        if (config_.clock) {
+            config_.clock->AdvanceTo(t);
+            return;
+        }
+        cv_.wait_until(lock, t);
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "sayo_screen_capture.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    // Manually driven clock for deterministic runs. Shared between a simulated
+    // device and anything else that needs to agree on "now".
+    class VirtualClock {
+    public:
+        SteadyClock::time_point Now() const {
+            return SteadyClock::time_point(SteadyClock::duration(nowTicks_.load(std::memory_order_acquire)));
+        }
+
+        void Advance(const SteadyClock::duration d) {
+            if (d.count() > 0) {
+                nowTicks_.fetch_add(d.count(), std::memory_order_acq_rel);
+            }
+        }
+
+        // Never moves backwards.
+        void AdvanceTo(const SteadyClock::time_point t) {
+            const auto target = t.time_since_epoch().count();
+            auto cur = nowTicks_.load(std::memory_order_acquire);
+            while (cur < target && !nowTicks_.compare_exchange_weak(cur, target, std::memory_order_acq_rel)) {
+            }
+        }
+
+    private:
+        std::atomic<SteadyClock::rep> nowTicks_{0};
+    };
+
+    struct SimulatedDeviceConfig {
+        uint16_t lcdW = 160;
+        uint16_t lcdH = 80;
+        uint8_t refreshRate = 60;
+
+        // 0x22/1024 mirrors usage_page=0xFF12, 0x21/64 mirrors usage_page=0xFF11.
+        uint8_t reportId = 0x22;
+        size_t reportLen = 1024;
+        size_t headerSize = 8;
+
+        // Time from a request being written until its first response report is ready.
+        uint32_t responseLatencyUs = 1000;
+        // Time between consecutive response reports.
+        uint32_t reportIntervalUs = 125;
+        // Uniform extra delay in [0, jitterUs] added to every report.
+        uint32_t jitterUs = 0;
+
+        // Probability (0..1) that a report is lost / arrives with a broken crc.
+        double dropRate = 0.0;
+        double corruptCrcRate = 0.0;
+        uint32_t seed = 1;
+
+        // When set, all timing runs on this clock and reads never really sleep.
+        // When null, reads block in real time.
+        VirtualClock* clock = nullptr;
+    };
+
+    struct SimulatedDeviceCounters {
+        uint64_t requests = 0;
+        uint64_t rejectedRequests = 0;
+        uint64_t reportsSent = 0;
+        uint64_t reportsDropped = 0;
+        uint64_t reportsCorrupted = 0;
+        uint64_t framesServed = 0;
+    };
+
+    // In-process stand-in for an O3C vendor collection. Answers SystemInfo (CMD 0x02)
+    // and streams the screen buffer (CMD 0x25) as address-prefixed chunks, the same
+    // way the firmware does.
+    class SimulatedDevice final : public Transport {
+    public:
+        // Called before every screen buffer request is served; fills the RGB565 frame.
+        using FrameGenerator = std::function<void(uint64_t frameIndex, std::vector<uint8_t>& rgb565)>;
+
+        explicit SimulatedDevice(const SimulatedDeviceConfig& config = {});
+
+        int Write(const uint8_t* data, size_t len) override;
+        int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) override;
+        SteadyClock::time_point Now() const override;
+
+        void SetFrameGenerator(FrameGenerator generator);
+
+        // Makes every subsequent read fail, like an unplugged device.
+        void Disconnect();
+
+        SimulatedDeviceCounters Counters() const;
+        const SimulatedDeviceConfig& Config() const {
+            return config_;
+        }
+
+        // Bytes of screen data carried by one CMD 0x25 report.
+        size_t ChunkPayloadBytes() const;
+
+    private:
+        struct Job {
+            uint8_t echo = 0;
+            uint8_t cmd = 0;
+            SteadyClock::time_point readyAt{};
+            uint32_t nextChunk = 0;
+            uint32_t chunkCount = 0;
+            // only for screen buffer jobs; the frame as it was when the request arrived
+            std::vector<uint8_t> frame;
+        };
+
+        SteadyClock::time_point next_due_locked();
+        size_t emit_report_locked(uint8_t* data, size_t len);
+        void wait_until(std::unique_lock<std::mutex>& lock, SteadyClock::time_point t);
+
+        SimulatedDeviceConfig config_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<Job> jobs_;
+        SteadyClock::time_point lastReportAt_{};
+        SteadyClock::time_point nextReportDue_{};
+        bool nextDueValid_ = false;
+        std::vector<uint8_t> frame_;
+        std::vector<uint8_t> report_;
+        uint64_t frameIndex_ = 0;
+        FrameGenerator generator_;
+        std::mt19937 rng_;
+        SimulatedDeviceCounters counters_{};
+        bool disconnected_ = false;
+    };
+}
@@ -0,0 +1,95 @@
+#include "sayo_spin_poll.h"
+
+#include <algorithm>
+
+namespace sayo {
+    SpinPollTransport::SpinPollTransport(Transport& inner, const SpinPollConfig& config)
+        : inner_(inner),
+          config_(config) {
+        windowStart_ = inner_.Now();
+    }
+
+    int SpinPollTransport::Write(const uint8_t* data, const size_t len) {
+        const int r = inner_.Write(data, len);
+        if (r >= 0) {
+            // a request went out, its response is due soon
+            lastActivity_ = inner_.Now();
+        }
+        return r;
+    }
+
+    bool SpinPollTransport::may_spin(const SteadyClock::time_point now) {
+        if (now - windowStart_ >= config_.budgetWindow) {
+            windowStart_ = now;
+            spentInWindow_ = {};
+        }
+        if (now - lastActivity_ > config_.expectWindow) {
+            return false;
+        }
+        const auto budget = std::chrono::duration_cast<SteadyClock::duration>(config_.budgetWindow * config_.cpuBudget);
+        if (spentInWindow_ >= budget) {
+            stats_.budgetExhaustedReads++;
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Read>
+    int SpinPollTransport::read_with_spin(const int timeoutMs, Read read) {
+        stats_.reads++;
+        const auto start = inner_.Now();
+        if (timeoutMs == 0 || !may_spin(start)) {
+            stats_.blockedReads++;
+            const int r = read(timeoutMs);
+            if (r > 0) {
+                lastActivity_ = inner_.Now();
+            }
+            return r;
+        }
+
+        SteadyClock::duration window = config_.spinWindow;
+        if (timeoutMs > 0) {
+            window = (std::min)(window, SteadyClock::duration(std::chrono::milliseconds(timeoutMs)));
+        }
+        const auto spinEnd = start + window;
+        int r = 0;
+        auto now = start;
+        do {
+            r = read(0);
+            now = inner_.Now();
+        } while (r == 0 && now < spinEnd);
+
+        const auto spun = now - start;
+        spentInWindow_ += spun;
+        stats_.spinUs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(spun).count());
+        if (r != 0) {
+            if (r > 0) {
+                stats_.spinHits++;
+                stats_.estimatedSavedUs += static_cast<uint64_t>(config_.assumedWakeupLatency.count());
+                lastActivity_ = now;
+            }
+            return r;
+        }
+
+        stats_.spinMisses++;
+        const auto spunMs = std::chrono::duration_cast<std::chrono::milliseconds>(spun).count();
+        const int remainingMs = timeoutMs < 0 ? timeoutMs : (std::max)(timeoutMs - static_cast<int>(spunMs), 0);
+        r = read(remainingMs);
+        if (r > 0) {
+            lastActivity_ = inner_.Now();
+        }
+        return r;
+    }
+
+    int SpinPollTransport::ReadTimeout(uint8_t* data, const size_t len, const int timeoutMs) {
+        return read_with_spin(timeoutMs, [&](const int ms) {
+            return inner_.ReadTimeout(data, len, ms);
+        });
+    }
+
+    int SpinPollTransport::ReadScatter(const ReadSlice* slices, const size_t count, const int timeoutMs) {
+        return read_with_spin(timeoutMs, [&](const int ms) {
+            return inner_.ReadScatter(slices, count, ms);
+        });
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "sayo_transport.h"
+
+namespace sayo {
+    struct SpinPollConfig {
+        // How long to busy-poll with non-blocking reads before falling back to a blocking wait.
+        std::chrono::microseconds spinWindow{250};
+        // Only spin while a report is due: within this long after the last report or write.
+        std::chrono::microseconds expectWindow{3000};
+        // Share of wall-clock time that may be spent spinning, per budgetWindow. Once it
+        // is used up every read blocks until the next window starts. 0 never spins.
+        double cpuBudget = 0.10;
+        std::chrono::milliseconds budgetWindow{1000};
+        // What a blocking read is assumed to add between the report arriving and the
+        // thread running again; only used for SpinPollStats::estimatedSavedUs.
+        std::chrono::microseconds assumedWakeupLatency{50};
+    };
+
+    struct SpinPollStats {
+        uint64_t reads = 0;
+        // reads answered while spinning
+        uint64_t spinHits = 0;
+        // spin windows that ran out and fell back to a blocking read
+        uint64_t spinMisses = 0;
+        // reads that blocked right away: nothing was due, or the budget was used up
+        uint64_t blockedReads = 0;
+        uint64_t budgetExhaustedReads = 0;
+        // time spent busy-polling, i.e. CPU burnt on this
+        uint64_t spinUs = 0;
+        // spinHits * assumedWakeupLatency
+        uint64_t estimatedSavedUs = 0;
+    };
+
+    // Low-latency read strategy: while a report is expected, poll the inner transport
+    // without blocking for a short window so the report is picked up the moment it
+    // lands, instead of after the scheduler wakes a blocked reader. Falls back to the
+    // inner blocking read when the window runs out, and stops spinning altogether once
+    // its CPU budget is spent. Wrap the transport handed to the capture functions;
+    // leave it out (or set cpuBudget to 0) for background captures.
+    class SpinPollTransport final : public Transport {
+    public:
+        explicit SpinPollTransport(Transport& inner, const SpinPollConfig& config = {});
+
+        int Write(const uint8_t* data, size_t len) override;
+        int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) override;
+        int ReadScatter(const ReadSlice* slices, size_t count, int timeoutMs) override;
+        SteadyClock::time_point Now() const override {
+            return inner_.Now();
+        }
+
+        SpinPollStats Stats() const {
+            return stats_;
+        }
+
+    private:
+        template <typename Read>
+        int read_with_spin(int timeoutMs, Read read);
+        bool may_spin(SteadyClock::time_point now);
+
+        Transport& inner_;
+        SpinPollConfig config_;
+        SpinPollStats stats_{};
+        SteadyClock::time_point lastActivity_{};
+        SteadyClock::time_point windowStart_{};
+        SteadyClock::duration spentInWindow_{};
+    };
+}
@@ -0,0 +1,78 @@
+#include "sayo_timing.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sayo {
+    namespace {
+        // RFC 6298 gains
+        constexpr double kMeanGain = 1.0 / 8.0;
+        constexpr double kDevGain = 1.0 / 4.0;
+
+        SteadyClock::duration from_us(const double us) {
+            return std::chrono::duration_cast<SteadyClock::duration>(std::chrono::duration<double, std::micro>(us));
+        }
+    }
+
+    void AdaptiveTiming::Estimate::add(const double us) {
+        if (samples == 0) {
+            mean = us;
+            dev = us / 2.0;
+        } else {
+            dev += kDevGain * (std::abs(us - mean) - dev);
+            mean += kMeanGain * (us - mean);
+        }
+        samples++;
+    }
+
+    AdaptiveTiming::AdaptiveTiming(const AdaptiveTimingConfig& config) : config_(config) {
+        // std::clamp needs lo <= hi
+        config_.maxIdleBreak = (std::max)(config_.maxIdleBreak, config_.minIdleBreak);
+        config_.deviationFactor = (std::max)(config_.deviationFactor, 0.0);
+    }
+
+    void AdaptiveTiming::ObserveInterArrival(const SteadyClock::duration gap) {
+        interArrival_.add(std::chrono::duration<double, std::micro>(gap).count());
+    }
+
+    void AdaptiveTiming::ObserveSilence(const SteadyClock::duration silence) {
+        interArrival_.add(std::chrono::duration<double, std::micro>(silence).count());
+    }
+
+    void AdaptiveTiming::ObserveFirstChunk(const SteadyClock::duration latency) {
+        firstChunk_.add(std::chrono::duration<double, std::micro>(latency).count());
+    }
+
+    SteadyClock::duration AdaptiveTiming::IdleBreak(const ProtocolConstants& proto) const {
+        if (config_.pinned || interArrival_.samples < config_.warmupSamples) {
+            return std::chrono::milliseconds(proto.idleBreakMs);
+        }
+        const auto estimate = from_us(interArrival_.mean + config_.deviationFactor * interArrival_.dev);
+        return std::clamp<SteadyClock::duration>(estimate, config_.minIdleBreak, config_.maxIdleBreak);
+    }
+
+    SteadyClock::duration AdaptiveTiming::FirstChunkTimeout(const ProtocolConstants& proto) const {
+        const SteadyClock::duration ceiling = std::chrono::milliseconds(proto.commandTimeoutMs);
+        if (config_.pinned || firstChunk_.samples < config_.warmupSamples) {
+            return ceiling;
+        }
+        const auto estimate = from_us(firstChunk_.mean + config_.deviationFactor * firstChunk_.dev);
+        return std::clamp<SteadyClock::duration>(
+            estimate, (std::min)(SteadyClock::duration(config_.minFirstChunkTimeout), ceiling), ceiling);
+    }
+
+    AdaptiveTimingStats AdaptiveTiming::Stats(const ProtocolConstants& proto) const {
+        AdaptiveTimingStats s{};
+        s.interArrivalSamples = interArrival_.samples;
+        s.firstChunkSamples = firstChunk_.samples;
+        s.interArrivalMeanUs = interArrival_.mean;
+        s.interArrivalDevUs = interArrival_.dev;
+        s.firstChunkMeanUs = firstChunk_.mean;
+        s.firstChunkDevUs = firstChunk_.dev;
+        s.idleBreakUs = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(IdleBreak(proto)).count());
+        s.firstChunkTimeoutUs = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(FirstChunkTimeout(proto)).count());
+        return s;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "sayo_screen_capture.h"
+#include "sayo_transport.h"
+
+namespace sayo {
+    struct AdaptiveTimingConfig {
+        // Keep using ProtocolConstants' static values; the estimates are still tracked.
+        bool pinned = false;
+        // Samples needed before the estimates replace the static values.
+        uint32_t warmupSamples = 16;
+        // threshold = mean + deviationFactor * mean deviation, then clamped
+        double deviationFactor = 4.0;
+        // Silence after a chunk before the rest of the frame is given up on.
+        std::chrono::microseconds minIdleBreak{1000};
+        std::chrono::microseconds maxIdleBreak{50000};
+        // Wait for the first chunk of a response before the request is given up on.
+        std::chrono::microseconds minFirstChunkTimeout{20000};
+    };
+
+    struct AdaptiveTimingStats {
+        uint64_t interArrivalSamples = 0;
+        uint64_t firstChunkSamples = 0;
+        double interArrivalMeanUs = 0.0;
+        double interArrivalDevUs = 0.0;
+        double firstChunkMeanUs = 0.0;
+        double firstChunkDevUs = 0.0;
+        // thresholds in use right now
+        uint32_t idleBreakUs = 0;
+        uint32_t firstChunkTimeoutUs = 0;
+    };
+
+    // Per-device estimate of how long to wait for CMD 0x25 chunks, learned from the
+    // chunks themselves (same smoothed mean + mean deviation scheme as TCP's RTO).
+    // Replaces idleBreakMs, and bounds the wait for the first chunk to well under
+    // commandTimeoutMs. Keep one per device and hand it to every capture through
+    // CaptureOptions::timing / FrameStreamOptions::timing. Not thread-safe.
+    class AdaptiveTiming {
+    public:
+        // A maxIdleBreak below minIdleBreak is raised to it, a negative deviationFactor to 0.
+        explicit AdaptiveTiming(const AdaptiveTimingConfig& config = {});
+
+        // Time between two consecutive chunks of one response (no lost chunk in between).
+        void ObserveInterArrival(SteadyClock::duration gap);
+        // A response went quiet for `silence` (at least IdleBreak()) and its tail was
+        // given up on. The real gap, if the tail was only late, was longer still; taken
+        // as an inter-arrival sample so that slow gaps, which always end the frame
+        // before they could be observed, still pull the idle break up.
+        void ObserveSilence(SteadyClock::duration silence);
+        // Time from writing a request to its first chunk.
+        void ObserveFirstChunk(SteadyClock::duration latency);
+
+        // Falls back to proto's static values while pinned or still warming up.
+        SteadyClock::duration IdleBreak(const ProtocolConstants& proto) const;
+        SteadyClock::duration FirstChunkTimeout(const ProtocolConstants& proto) const;
+
+        AdaptiveTimingStats Stats(const ProtocolConstants& proto = {}) const;
+        const AdaptiveTimingConfig& Config() const {
+            return config_;
+        }
+
+    private:
+        struct Estimate {
+            double mean = 0.0;
+            double dev = 0.0;
+            uint64_t samples = 0;
+
+            void add(double us);
+        };
+
+        AdaptiveTimingConfig config_;
+        Estimate interArrival_;
+        Estimate firstChunk_;
+    };
+}
@@ -0,0 +1,494 @@
+#include "sayo_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sayo {
+    namespace {
+        constexpr char kTraceMagic[8] = {'S', 'A', 'Y', 'O', 'T', 'R', 'C', '1'};
+        constexpr uint16_t kTraceVersion = 1;
+        constexpr size_t kTraceHeaderBytes = 32;
+        constexpr size_t kRecordHeaderBytes = 8;
+        constexpr size_t kDataBytesOffset = 24;
+        constexpr size_t kInitialTraceBytes = 1u << 20;
+
+        void put_u16(uint8_t* p, const uint16_t v) {
+            p[0] = static_cast<uint8_t>(v & 0xFF);
+            p[1] = static_cast<uint8_t>(v >> 8);
+        }
+
+        void put_u32(uint8_t* p, const uint32_t v) {
+            for (int i = 0; i < 4; i++) {
+                p[i] = static_cast<uint8_t>((v >> (8 * i)) & 0xFF);
+            }
+        }
+
+        void put_u64(uint8_t* p, const uint64_t v) {
+            for (int i = 0; i < 8; i++) {
+                p[i] = static_cast<uint8_t>((v >> (8 * i)) & 0xFF);
+            }
+        }
+
+        uint16_t get_u16(const uint8_t* p) {
+            return static_cast<uint16_t>(p[0] | (static_cast<uint16_t>(p[1]) << 8));
+        }
+
+        uint32_t get_u32(const uint8_t* p) {
+            uint32_t v = 0;
+            for (int i = 3; i >= 0; i--) {
+                v = (v << 8) | p[i];
+            }
+            return v;
+        }
+
+        uint64_t get_u64(const uint8_t* p) {
+            uint64_t v = 0;
+            for (int i = 7; i >= 0; i--) {
+                v = (v << 8) | p[i];
+            }
+            return v;
+        }
+
+        SteadyClock::time_point trace_time(const TraceRecord& rec) {
+            return SteadyClock::time_point(std::chrono::microseconds(rec.timeUs));
+        }
+    }
+
+    namespace detail {
+        MappedFile::~MappedFile() {
+            Close(size_);
+        }
+
+#if defined(_WIN32)
+        bool MappedFile::OpenRead(const std::string& path) {
+            Close();
+            const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                            FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER size{};
+            if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+                CloseHandle(file);
+                return false;
+            }
+            file_ = file;
+            writable_ = false;
+            if (!map(static_cast<size_t>(size.QuadPart))) {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        bool MappedFile::OpenWrite(const std::string& path, const size_t initialSize) {
+            Close();
+            const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            file_ = file;
+            writable_ = true;
+            if (!map(initialSize)) {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        bool MappedFile::map(const size_t size) {
+            const auto size64 = static_cast<unsigned long long>(size);
+            const HANDLE mapping = CreateFileMappingA(
+                static_cast<HANDLE>(file_),
+                nullptr,
+                writable_ ? PAGE_READWRITE : PAGE_READONLY,
+                static_cast<DWORD>(size64 >> 32),
+                static_cast<DWORD>(size64 & 0xFFFFFFFFull),
+                nullptr);
+            if (!mapping) {
+                return false;
+            }
+            void* view = MapViewOfFile(mapping, writable_ ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+            if (!view) {
+                CloseHandle(mapping);
+                return false;
+            }
+            mapping_ = mapping;
+            data_ = static_cast<uint8_t*>(view);
+            size_ = size;
+            return true;
+        }
+
+        void MappedFile::unmap() {
+            if (data_) {
+                UnmapViewOfFile(data_);
+                data_ = nullptr;
+            }
+            if (mapping_) {
+                CloseHandle(static_cast<HANDLE>(mapping_));
+                mapping_ = nullptr;
+            }
+        }
+
+        void MappedFile::Close(const size_t finalSize) {
+            unmap();
+            if (file_) {
+                if (writable_) {
+                    LARGE_INTEGER pos{};
+                    pos.QuadPart = static_cast<LONGLONG>(finalSize);
+                    if (SetFilePointerEx(static_cast<HANDLE>(file_), pos, nullptr, FILE_BEGIN)) {
+                        SetEndOfFile(static_cast<HANDLE>(file_));
+                    }
+                }
+                CloseHandle(static_cast<HANDLE>(file_));
+                file_ = nullptr;
+            }
+            size_ = 0;
+        }
+#else
+        bool MappedFile::OpenRead(const std::string& path) {
+            Close();
+            const int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat st{};
+            if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+                close(fd);
+                return false;
+            }
+            fd_ = fd;
+            writable_ = false;
+            if (!map(static_cast<size_t>(st.st_size))) {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        bool MappedFile::OpenWrite(const std::string& path, const size_t initialSize) {
+            Close();
+            const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                return false;
+            }
+            fd_ = fd;
+            writable_ = true;
+            if (!map(initialSize)) {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        bool MappedFile::map(const size_t size) {
+            if (writable_ && ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+                return false;
+            }
+            void* view = mmap(nullptr, size, writable_ ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                              writable_ ? MAP_SHARED : MAP_PRIVATE, fd_, 0);
+            if (view == MAP_FAILED) {
+                return false;
+            }
+            data_ = static_cast<uint8_t*>(view);
+            size_ = size;
+            return true;
+        }
+
+        void MappedFile::unmap() {
+            if (data_) {
+                munmap(data_, size_);
+                data_ = nullptr;
+            }
+        }
+
+        void MappedFile::Close(const size_t finalSize) {
+            unmap();
+            if (fd_ >= 0) {
+                if (writable_) {
+                    (void)ftruncate(fd_, static_cast<off_t>(finalSize));
+                }
+                close(fd_);
+                fd_ = -1;
+            }
+            size_ = 0;
+        }
+#endif
+
+        bool MappedFile::Grow(const size_t newSize) {
+            if (!writable_ || !data_ || newSize <= size_) {
+                return writable_ && data_;
+            }
+            unmap();
+            return map(newSize);
+        }
+    }
+
+    TraceWriter::~TraceWriter() {
+        Close();
+    }
+
+    bool TraceWriter::Open(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_.IsOpen()) {
+            // finish the trace being written; OpenWrite's own Close() would truncate it to nothing
+            file_.Close(used_);
+        }
+        if (!file_.OpenWrite(path, kInitialTraceBytes)) {
+            return false;
+        }
+        uint8_t* h = file_.Data();
+        std::memset(h, 0, kTraceHeaderBytes);
+        std::memcpy(h, kTraceMagic, sizeof(kTraceMagic));
+        put_u16(h + 8, kTraceVersion);
+        put_u16(h + 10, static_cast<uint16_t>(kTraceHeaderBytes));
+        const auto wallUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        put_u64(h + 16, static_cast<uint64_t>(wallUs));
+        used_ = kTraceHeaderBytes;
+        records_ = 0;
+        haveLast_ = false;
+        return true;
+    }
+
+    void TraceWriter::Append(const TraceDirection direction, const SteadyClock::time_point time, const uint8_t* data,
+                             size_t len) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_.IsOpen()) {
+            return;
+        }
+        len = (std::min)(len, static_cast<size_t>((std::numeric_limits<uint16_t>::max)()));
+        const size_t need = kRecordHeaderBytes + len;
+        if (used_ + need > file_.Size()) {
+            if (!file_.Grow((std::max)(file_.Size() * 2, used_ + need))) {
+                return;
+            }
+        }
+
+        uint32_t deltaUs = 0;
+        if (haveLast_ && time > last_) {
+            const auto us = std::chrono::duration_cast<std::chrono::microseconds>(time - last_).count();
+            deltaUs = static_cast<uint32_t>((std::min<long long>)(us, (std::numeric_limits<uint32_t>::max)()));
+        }
+        if (!haveLast_ || time > last_) {
+            last_ = time;
+            haveLast_ = true;
+        }
+
+        uint8_t* rec = file_.Data() + used_;
+        put_u32(rec, deltaUs);
+        rec[4] = static_cast<uint8_t>(direction);
+        rec[5] = (data && len > 0) ? data[0] : 0;
+        put_u16(rec + 6, static_cast<uint16_t>(len));
+        if (len > 0) {
+            std::memcpy(rec + kRecordHeaderBytes, data, len);
+        }
+        used_ += need;
+        records_++;
+        put_u64(file_.Data() + kDataBytesOffset, used_ - kTraceHeaderBytes);
+    }
+
+    void TraceWriter::Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_.IsOpen()) {
+            file_.Close(used_);
+        }
+    }
+
+    bool TraceWriter::IsOpen() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return file_.IsOpen();
+    }
+
+    uint64_t TraceWriter::RecordCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return records_;
+    }
+
+    bool TraceReader::Open(const std::string& path) {
+        Close();
+        if (!file_.OpenRead(path)) {
+            return false;
+        }
+        const uint8_t* h = file_.Data();
+        if (file_.Size() < kTraceHeaderBytes || std::memcmp(h, kTraceMagic, sizeof(kTraceMagic)) != 0 ||
+            get_u16(h + 8) != kTraceVersion) {
+            Close();
+            return false;
+        }
+        const size_t headerBytes = get_u16(h + 10);
+        const uint64_t dataBytes = get_u64(h + kDataBytesOffset);
+        if (headerBytes < kTraceHeaderBytes || headerBytes > file_.Size()) {
+            Close();
+            return false;
+        }
+        const size_t end = static_cast<size_t>((std::min<uint64_t>)(headerBytes + dataBytes, file_.Size()));
+
+        uint64_t timeUs = 0;
+        size_t pos = headerBytes;
+        while (pos + kRecordHeaderBytes <= end) {
+            const uint8_t* p = file_.Data() + pos;
+            TraceRecord rec{};
+            timeUs += get_u32(p);
+            rec.timeUs = timeUs;
+            rec.direction = static_cast<TraceDirection>(p[4]);
+            rec.reportId = p[5];
+            rec.len = get_u16(p + 6);
+            if (pos + kRecordHeaderBytes + rec.len > end) {
+                break; // truncated tail
+            }
+            rec.data = p + kRecordHeaderBytes;
+            records_.push_back(rec);
+            pos += kRecordHeaderBytes + rec.len;
+        }
+        return true;
+    }
+
+    void TraceReader::Close() {
+        records_.clear();
+        file_.Close();
+    }
+
+    int RecordingTransport::Write(const uint8_t* data, const size_t len) {
+        const int r = inner_.Write(data, len);
+        if (r >= 0) {
+            writer_.Append(TraceDirection::HostToDevice, inner_.Now(), data, len);
+        }
+        return r;
+    }
+
+    int RecordingTransport::ReadTimeout(uint8_t* data, const size_t len, const int timeoutMs) {
+        const int r = inner_.ReadTimeout(data, len, timeoutMs);
+        if (r > 0) {
+            writer_.Append(TraceDirection::DeviceToHost, inner_.Now(), data, static_cast<size_t>(r));
+        } else if (r < 0) {
+            writer_.Append(TraceDirection::DeviceError, inner_.Now(), nullptr, 0);
+        }
+        return r;
+    }
+
+    ReplayTransport::ReplayTransport(const TraceReader& reader, const ReplayPacing pacing)
+        : records_(reader.Records()),
+          pacing_(pacing),
+          anchor_(SteadyClock::now()) {
+    }
+
+    SteadyClock::time_point ReplayTransport::Now() const {
+        if (pacing_ == ReplayPacing::AsFastAsPossible) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return virtualNow_;
+        }
+        return SteadyClock::now();
+    }
+
+    int ReplayTransport::Write(const uint8_t* data, const size_t len) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t i = writeCursor_;
+        while (i < records_.size() && records_[i].direction != TraceDirection::HostToDevice) {
+            i++;
+        }
+        if (i >= records_.size()) {
+            stats_.writesPastEnd++;
+            return -1;
+        }
+
+        const TraceRecord& rec = records_[i];
+        if (rec.len == len && std::memcmp(rec.data, data, len) == 0) {
+            stats_.writesMatched++;
+        } else {
+            stats_.writesMismatched++;
+        }
+        writeCursor_ = i + 1;
+
+        if (pacing_ == ReplayPacing::AsFastAsPossible) {
+            virtualNow_ = (std::max)(virtualNow_, trace_time(rec));
+        } else {
+            anchor_ = SteadyClock::now() - std::chrono::microseconds(rec.timeUs);
+        }
+        return static_cast<int>(len);
+    }
+
+    int ReplayTransport::ReadTimeout(uint8_t* data, const size_t len, const int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const auto timeout = std::chrono::milliseconds((std::max)(timeoutMs, 0));
+        const auto deadline = SteadyClock::now() + timeout;
+        for (;;) {
+            // writes the code under test already replayed are not barriers any more
+            while (readCursor_ < records_.size() && readCursor_ < writeCursor_ &&
+                records_[readCursor_].direction == TraceDirection::HostToDevice) {
+                readCursor_++;
+            }
+            if (readCursor_ >= records_.size()) {
+                return -1;
+            }
+
+            const TraceRecord& rec = records_[readCursor_];
+            if (rec.direction == TraceDirection::DeviceError) {
+                readCursor_++;
+                return -1;
+            }
+
+            if (rec.direction == TraceDirection::DeviceToHost) {
+                if (pacing_ == ReplayPacing::AsFastAsPossible) {
+                    virtualNow_ = (std::max)(virtualNow_, trace_time(rec));
+                } else {
+                    const auto due = anchor_ + std::chrono::microseconds(rec.timeUs);
+                    if (due > SteadyClock::now()) {
+                        lock.unlock();
+                        std::this_thread::sleep_until((std::min)(due, deadline));
+                        lock.lock();
+                        if (SteadyClock::now() < due) {
+                            if (SteadyClock::now() >= deadline) {
+                                return 0;
+                            }
+                            continue;
+                        }
+                    }
+                }
+                const size_t n = (std::min)(len, static_cast<size_t>(rec.len));
+                std::memcpy(data, rec.data, n);
+                readCursor_++;
+                stats_.reportsDelivered++;
+                return static_cast<int>(n);
+            }
+
+            // The next thing in the trace is a request the code under test hasn't sent yet.
+            if (pacing_ == ReplayPacing::AsFastAsPossible) {
+                virtualNow_ += timeoutMs > 0 ? SteadyClock::duration(timeout) : std::chrono::microseconds(1);
+                return 0;
+            }
+            if (SteadyClock::now() >= deadline) {
+                return 0;
+            }
+            lock.unlock();
+            std::this_thread::sleep_until(deadline);
+            lock.lock();
+        }
+    }
+
+    ReplayStats ReplayTransport::Stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    bool ReplayTransport::AtEnd() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return readCursor_ >= records_.size();
+    }
+}
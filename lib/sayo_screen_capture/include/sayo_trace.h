@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sayo_transport.h"
+
+// Raw HID traffic traces. A trace is a memory-mapped file of timestamped reports:
+//
+//   header (32 bytes): "SAYOTRC1", u16 version, u16 header size, u32 flags,
+//                      u64 wall clock start (unix us), u64 bytes of record data
+//   record (8 + len):  u32 us since previous record, u8 direction, u8 report id,
+//                      u16 len, then len raw report bytes
+//
+// All integers are little-endian. The data byte count in the header is updated on
+// every append, so a trace cut short by a crash is still readable.
+namespace sayo {
+    enum class TraceDirection : uint8_t {
+        HostToDevice = 0,
+        DeviceToHost = 1,
+        // a read that failed; replaying it reproduces the disconnect
+        DeviceError = 2,
+    };
+
+    struct TraceRecord {
+        uint64_t timeUs = 0; // since the first record
+        TraceDirection direction = TraceDirection::DeviceToHost;
+        uint8_t reportId = 0;
+        uint16_t len = 0;
+        const uint8_t* data = nullptr; // points into the mapping
+    };
+
+    namespace detail {
+        class MappedFile {
+        public:
+            MappedFile() = default;
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            ~MappedFile();
+
+            bool OpenRead(const std::string& path);
+            bool OpenWrite(const std::string& path, size_t initialSize);
+            // Write mode only. Remaps, so previously returned pointers are invalidated.
+            bool Grow(size_t newSize);
+            // In write mode, truncates the file to finalSize before closing.
+            void Close(size_t finalSize = 0);
+
+            uint8_t* Data() const {
+                return data_;
+            }
+            size_t Size() const {
+                return size_;
+            }
+            bool IsOpen() const {
+                return data_ != nullptr;
+            }
+
+        private:
+            bool map(size_t size);
+            void unmap();
+
+            uint8_t* data_ = nullptr;
+            size_t size_ = 0;
+            bool writable_ = false;
+#if defined(_WIN32)
+            void* file_ = nullptr;
+            void* mapping_ = nullptr;
+#else
+            int fd_ = -1;
+#endif
+        };
+    }
+
+    class TraceWriter {
+    public:
+        TraceWriter() = default;
+        TraceWriter(const TraceWriter&) = delete;
+        TraceWriter& operator=(const TraceWriter&) = delete;
+        ~TraceWriter();
+
+        // Closes the trace already open first, as Close() does.
+        bool Open(const std::string& path);
+        void Append(TraceDirection direction, SteadyClock::time_point time, const uint8_t* data, size_t len);
+        // Trims the preallocated tail off the file.
+        void Close();
+
+        bool IsOpen() const;
+        uint64_t RecordCount() const;
+
+    private:
+        mutable std::mutex mutex_;
+        detail::MappedFile file_;
+        size_t used_ = 0;
+        uint64_t records_ = 0;
+        bool haveLast_ = false;
+        SteadyClock::time_point last_{};
+    };
+
+    class TraceReader {
+    public:
+        bool Open(const std::string& path);
+        void Close();
+
+        const std::vector<TraceRecord>& Records() const {
+            return records_;
+        }
+
+    private:
+        detail::MappedFile file_;
+        std::vector<TraceRecord> records_;
+    };
+
+    // Passes everything through to another transport and tees it into a trace.
+    class RecordingTransport final : public Transport {
+    public:
+        RecordingTransport(Transport& inner, TraceWriter& writer) : inner_(inner), writer_(writer) {}
+
+        int Write(const uint8_t* data, size_t len) override;
+        int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) override;
+        SteadyClock::time_point Now() const override {
+            return inner_.Now();
+        }
+
+    private:
+        Transport& inner_;
+        TraceWriter& writer_;
+    };
+
+    enum class ReplayPacing : uint8_t {
+        // Reports become readable at their recorded offsets, re-anchored on every write.
+        Recorded = 0,
+        // No sleeping; Now() follows the trace's timestamps so durations stay meaningful.
+        AsFastAsPossible,
+    };
+
+    struct ReplayStats {
+        uint64_t reportsDelivered = 0;
+        uint64_t writesMatched = 0;
+        uint64_t writesMismatched = 0;
+        uint64_t writesPastEnd = 0;
+    };
+
+    // Feeds a recorded trace back to the capture code. Device-to-host reports are
+    // delivered in order; recorded writes act as barriers, so a response is never
+    // handed out before the code under test has sent the request that caused it.
+    // Reading past the end of the trace returns -1, like a disconnected device.
+    class ReplayTransport final : public Transport {
+    public:
+        ReplayTransport(const TraceReader& reader, ReplayPacing pacing);
+
+        int Write(const uint8_t* data, size_t len) override;
+        int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) override;
+        SteadyClock::time_point Now() const override;
+
+        ReplayStats Stats() const;
+        bool AtEnd() const;
+
+    private:
+        const std::vector<TraceRecord>& records_;
+        const ReplayPacing pacing_;
+        mutable std::mutex mutex_;
+        size_t readCursor_ = 0;
+        size_t writeCursor_ = 0;
+        SteadyClock::time_point virtualNow_{};
+        SteadyClock::time_point anchor_{};
+        ReplayStats stats_{};
+    };
+}
@@ -0,0 +1,45 @@
+#include "sayo_transport.h"
+#include "sayo_protocol.h"
+
+#include <vector>
+
+#include "hidapi.h"
+
+namespace sayo {
+    int Transport::ReadScatter(const ReadSlice* slices, const size_t count, const int timeoutMs) {
+        thread_local std::vector<uint8_t> bounce;
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            total += slices[i].len;
+        }
+        if (bounce.size() < total) {
+            bounce.resize(total);
+        }
+        const int r = ReadTimeout(bounce.data(), total, timeoutMs);
+        if (r <= 0) {
+            return r;
+        }
+        detail::scatter_copy(bounce.data(), static_cast<size_t>(r), slices, count);
+        return r;
+    }
+
+    HidapiTransport::~HidapiTransport() {
+        if (owned_ && dev_) {
+            hid_close(dev_);
+        }
+    }
+
+    int HidapiTransport::Write(const uint8_t* data, const size_t len) {
+        if (!dev_) {
+            return -1;
+        }
+        return hid_write(dev_, data, len);
+    }
+
+    int HidapiTransport::ReadTimeout(uint8_t* data, const size_t len, const int timeoutMs) {
+        if (!dev_) {
+            return -1;
+        }
+        return hid_read_timeout(dev_, data, len, timeoutMs);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+struct hid_device;
+
+namespace sayo {
+    using SteadyClock = std::chrono::steady_clock;
+
+    struct ReadSlice {
+        uint8_t* data = nullptr;
+        size_t len = 0;
+    };
+
+    // Byte-level link to a SayoDevice vendor collection. The capture functions only
+    // ever talk to the device through this, so they can run against real hardware,
+    // the simulated device or a recorded trace.
+    class Transport {
+    public:
+        virtual ~Transport() = default;
+
+        // Same contract as hid_write: number of bytes written, or -1 on error.
+        virtual int Write(const uint8_t* data, size_t len) = 0;
+
+        // Same contract as hid_read_timeout: bytes read, 0 on timeout, -1 on error.
+        // timeoutMs == 0 is a non-blocking read.
+        virtual int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) = 0;
+
+        // Reads one report spread over the slices in order (readv style), so the
+        // payload can land directly in its final buffer. Returns the total byte count
+        // like ReadTimeout. The default bounces through a buffer and copies.
+        virtual int ReadScatter(const ReadSlice* slices, size_t count, int timeoutMs);
+
+        // Asks the transport to call onReadable, from its own thread, whenever reports
+        // become readable or it fails, so a caller can wait for the device without
+        // blocking a thread in ReadTimeout. Only transports that read in the background
+        // can; false means the caller still has to block. An empty function unregisters
+        // it; once that returns, no call is running or will start.
+        virtual bool SetReadableCallback(std::function<void()> onReadable) {
+            (void)onReadable;
+            return false;
+        }
+
+        // Clock used for every capture deadline. Simulated transports hand out virtual time here.
+        virtual SteadyClock::time_point Now() const {
+            return SteadyClock::now();
+        }
+    };
+
+    // Thin adapter over an hidapi handle (as returned by OpenVendorInterface). Only
+    // closes the handle when constructed with closeOnDestroy.
+    class HidapiTransport final : public Transport {
+    public:
+        explicit HidapiTransport(hid_device* dev, bool closeOnDestroy = false)
+            : dev_(dev),
+              owned_(closeOnDestroy) {
+        }
+        HidapiTransport(const HidapiTransport&) = delete;
+        HidapiTransport& operator=(const HidapiTransport&) = delete;
+        ~HidapiTransport() override;
+
+        int Write(const uint8_t* data, size_t len) override;
+        int ReadTimeout(uint8_t* data, size_t len, int timeoutMs) override;
+
+        hid_device* Handle() const {
+            return dev_;
+        }
+
+    private:
+        hid_device* dev_ = nullptr;
+        bool owned_ = false;
+    };
+}
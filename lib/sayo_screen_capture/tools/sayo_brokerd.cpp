@@ -0,0 +1,213 @@
+// Frame broker daemon: opens the vendor collection over hidraw, serves it to local
+// clients through FrameBroker and gets the device back after an unplug.
+//
+//   sayo_brokerd [--socket PATH] [--slots N] [--vid HEX --pid HEX] [--simulate]
+//
+// The socket defaults to $XDG_RUNTIME_DIR/sayo-broker.sock (/tmp without it).
+// --simulate serves a SimulatedDevice instead of hardware. Runs until SIGINT or
+// SIGTERM and prints the broker's stats every ten seconds.
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "sayo_bringup.h"
+#include "sayo_broker.h"
+#include "sayo_hidraw.h"
+#include "sayo_protocol.h"
+#include "sayo_reconnect.h"
+#include "sayo_sim_device.h"
+
+namespace {
+    struct DaemonConfig {
+        std::string socketPath;
+        uint32_t slots = 4;
+        sayo::DeviceIds ids{};
+        bool simulate = false;
+    };
+
+    // BringUpBackend over EnumerateHidraw, for the Reconnector. hidraw has no serial
+    // number at hand, so a device is keyed by its node.
+    class HidrawBringUpBackend final : public sayo::BringUpBackend {
+    public:
+        explicit HidrawBringUpBackend(const sayo::DeviceIds& ids) : ids_(ids) {}
+
+        std::vector<sayo::OpenHint> Enumerate() override {
+            std::vector<sayo::HidrawDeviceInfo> devs = sayo::EnumerateHidraw(ids_);
+            std::erase_if(devs, [](const sayo::HidrawDeviceInfo& d) { return rank(d) < 0; });
+            // ties keep enumeration order, like OpenHidrawVendorInterface
+            std::stable_sort(devs.begin(), devs.end(), [](const sayo::HidrawDeviceInfo& a,
+                                                          const sayo::HidrawDeviceInfo& b) {
+                return rank(a) < rank(b);
+            });
+            std::vector<sayo::OpenHint> out;
+            for (const sayo::HidrawDeviceInfo& d : devs) {
+                out.push_back(sayo::OpenHint{d.path, d.usagePage});
+            }
+            return out;
+        }
+
+        std::optional<sayo::OpenedDevice> Open(const sayo::OpenHint& where) override {
+            // nodes get reused when devices are replugged: it must still carry the collection
+            const std::vector<sayo::HidrawDeviceInfo> devs = sayo::EnumerateHidraw(ids_);
+            const bool listed = std::any_of(devs.begin(), devs.end(), [&](const sayo::HidrawDeviceInfo& d) {
+                return d.path == where.path && d.usagePage == where.usagePage && rank(d) >= 0;
+            });
+            if (!listed) {
+                return std::nullopt;
+            }
+            const int fd = open(where.path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0) {
+                return std::nullopt;
+            }
+            sayo::OpenedDevice opened;
+            opened.transport = std::make_unique<sayo::HidrawTransport>(fd);
+            opened.path = where.path;
+            opened.usagePage = where.usagePage;
+            opened.key = where.path;
+            return opened;
+        }
+
+    private:
+        static int rank(const sayo::HidrawDeviceInfo& d) {
+            return sayo::detail::vendor_collection_rank(d.interfaceNumber, d.usagePage, d.usage);
+        }
+
+        sayo::DeviceIds ids_;
+    };
+
+    // The simulator is always there; --simulate only needs Open() for the first device.
+    class SimulatedBringUpBackend final : public sayo::BringUpBackend {
+    public:
+        std::vector<sayo::OpenHint> Enumerate() override {
+            return {sayo::OpenHint{"simulated", 0xFF12}};
+        }
+
+        std::optional<sayo::OpenedDevice> Open(const sayo::OpenHint& where) override {
+            sayo::OpenedDevice opened;
+            opened.transport = std::make_unique<sayo::SimulatedDevice>();
+            opened.path = where.path;
+            opened.usagePage = where.usagePage;
+            opened.key = "simulated";
+            return opened;
+        }
+    };
+
+    bool parse_args(const int argc, char** argv, DaemonConfig& config) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (std::strcmp(arg, "--simulate") == 0) {
+                config.simulate = true;
+            } else if (value && std::strcmp(arg, "--socket") == 0) {
+                config.socketPath = value;
+                i++;
+            } else if (value && std::strcmp(arg, "--slots") == 0) {
+                config.slots = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+                i++;
+            } else if (value && std::strcmp(arg, "--vid") == 0) {
+                config.ids.vid = static_cast<unsigned short>(std::strtoul(value, nullptr, 16));
+                i++;
+            } else if (value && std::strcmp(arg, "--pid") == 0) {
+                config.ids.pid = static_cast<unsigned short>(std::strtoul(value, nullptr, 16));
+                i++;
+            } else {
+                std::fprintf(stderr, "unknown or incomplete argument: %s\n", arg);
+                return false;
+            }
+        }
+        if (config.socketPath.empty()) {
+            const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+            config.socketPath = std::string(runtimeDir && *runtimeDir ? runtimeDir : "/tmp") + "/sayo-broker.sock";
+        }
+        return true;
+    }
+
+    std::optional<sayo::OpenedDevice> open_first(sayo::BringUpBackend& backend) {
+        for (const sayo::OpenHint& hint : backend.Enumerate()) {
+            if (std::optional<sayo::OpenedDevice> opened = backend.Open(hint)) {
+                return opened;
+            }
+        }
+        return std::nullopt;
+    }
+}
+
+int main(const int argc, char** argv) {
+    DaemonConfig config{};
+    if (!parse_args(argc, argv, config)) {
+        return 2;
+    }
+
+    // Blocked before any thread starts, so only sigtimedwait below sees them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    std::unique_ptr<sayo::BringUpBackend> backend;
+    if (config.simulate) {
+        backend = std::make_unique<SimulatedBringUpBackend>();
+    } else {
+        backend = std::make_unique<HidrawBringUpBackend>(config.ids);
+    }
+    std::optional<sayo::OpenedDevice> device = open_first(*backend);
+    if (!device) {
+        std::fprintf(stderr, "no vendor collection for %04x:%04x could be opened\n", config.ids.vid, config.ids.pid);
+        return 1;
+    }
+    sayo::ProtocolConstants proto{};
+    if (!sayo::ConfigureForUsagePage(device->usagePage, proto)) {
+        std::fprintf(stderr, "%s: unsupported usage page 0x%04x\n", device->path.c_str(), device->usagePage);
+        return 1;
+    }
+    const std::optional<sayo::SystemInfo> info = sayo::TryGetSystemInfo(*device->transport, proto);
+    if (!info || info->lcdW == 0 || info->lcdH == 0) {
+        std::fprintf(stderr, "%s: no SystemInfo response\n", device->path.c_str());
+        return 1;
+    }
+
+    sayo::Reconnector reconnector(*backend);
+    sayo::BrokerOptions options{};
+    options.socketPath = config.socketPath;
+    options.slots = config.slots;
+    options.reconnector = &reconnector;
+    const std::string devicePath = device->path;
+    sayo::FrameBroker broker(std::move(*device), *info, proto, options);
+    if (!broker.Listen()) {
+        std::fprintf(stderr, "%s: %s\n", config.socketPath.c_str(), std::strerror(errno));
+        return 1;
+    }
+    broker.Start();
+    std::fprintf(stderr, "serving %s (%ux%u) on %s\n", devicePath.c_str(), info->lcdW, info->lcdH,
+                 config.socketPath.c_str());
+
+    const timespec statsPeriod{10, 0};
+    for (;;) {
+        const int sig = sigtimedwait(&signals, nullptr, &statsPeriod);
+        if (sig == SIGINT || sig == SIGTERM) {
+            break;
+        }
+        if (sig < 0 && errno == EAGAIN) {
+            const sayo::BrokerStats s = broker.Stats();
+            std::fprintf(stderr, "fps %.1f frames %llu incomplete %llu drops %llu clients %u\n", s.fps,
+                         static_cast<unsigned long long>(s.frames),
+                         static_cast<unsigned long long>(s.framesIncomplete),
+                         static_cast<unsigned long long>(s.deviceDrops), s.clientsConnected);
+        }
+    }
+    broker.Stop();
+    return 0;
+}
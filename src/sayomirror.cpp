@@ -30,11 +30,41 @@ LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 
 namespace {
     constexpr UINT_PTR kPresentTimerId = 1;
-}
 
-void sayomirror::HidDeviceDeleter::operator()(hid_device* d) const noexcept {
-    if (d) {
-        hid_close(d);
+    void SetStatusText(sayomirror::AppState* appState, std::wstring text) {
+        appState->statusText = std::move(text);
+    }
+
+    std::wstring BringUpStatusText(const sayo::BringUpStage stage, const sayo::BringUpError error) {
+        switch (stage) {
+        case sayo::BringUpStage::Idle:
+        case sayo::BringUpStage::Enumerating:
+            return L"Looking for your SayoDevice...";
+        case sayo::BringUpStage::Opening:
+            return L"Opening SayoDevice...";
+        case sayo::BringUpStage::QueryingInfo:
+            return L"Reading SayoDevice screen info...";
+        case sayo::BringUpStage::Ready:
+            return {};
+        case sayo::BringUpStage::Failed:
+            break;
+        }
+        switch (error) {
+        case sayo::BringUpError::UnsupportedInterface:
+            return L"Found a legacy SayoDevice HID interface (usage_page=0xFF00), but sayomirror currently needs the HID v2 interface "
+                   L"(usage_page=0xFF11 or 0xFF12) to read the framebuffer.";
+        case sayo::BringUpError::InfoTimeout:
+            return L"Opened device, but LCD size query timed out.";
+        case sayo::BringUpError::InvalidInfo:
+            return L"Device reported invalid LCD size.";
+        case sayo::BringUpError::Cancelled:
+            return L"Device bring-up cancelled.";
+        case sayo::BringUpError::None:
+        case sayo::BringUpError::NotFound:
+            break;
+        }
+        return L"No compatible SayoDevice HID interface found :(\n\n"
+               L"Please make a GitHub Issue at https://github.com/dioxair/sayomirror and follow the directions to report this bug";
     }
 }
 
@@ -146,70 +176,68 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             break;
         }
 
-        const sayo::OpenResult opened = OpenVendorInterface(appState->ids, sayo::OutputStream::StdOut);
-        appState->dev.reset(opened.handle);
-        if (!appState->dev) {
-            appState->statusText =
-                L"No compatible SayoDevice HID interface found :(\n\n"
-                L"Please make a GitHub Issue at https://github.com/dioxair/sayomirror and follow the directions to report this bug";
-            sayomirror::logging::LogLine(appState->statusText);
-            break;
+        if (!appState->infoCache.Load(sayomirror::logging::GetExeDirectory() / L"sayomirror-devices.cache")) {
+            sayomirror::logging::LogLine(L"Could not read the device info cache, starting without it.");
         }
 
-        // usage_page=0xFF12: report_id 0x22, 1024-byte reports (high-speed)
-        // usage_page=0xFF11: report_id 0x21, 64-byte reports (other polling rates)
-        if (opened.usagePage == 0xFF11) {
-            appState->proto.reportId22 = 0x21;
-            appState->proto.reportLen22 = 64;
-        } else if (opened.usagePage == 0xFF12) {
-            appState->proto.reportId22 = 0x22;
-            appState->proto.reportLen22 = 1024;
-        } else if (opened.usagePage == 0xFF00) {
-            appState->statusText =
-                L"Found a legacy SayoDevice HID interface (usage_page=0xFF00), but sayomirror currently needs the HID v2 interface "
-                L"(usage_page=0xFF11 or 0xFF12) to read the framebuffer.";
-            sayomirror::logging::LogLine(appState->statusText);
-            break;
-        }
-
-        sayomirror::logging::LogLine(std::format(
-            L"Opening path: {} (interface={} usage_page=0x{:x} usage=0x{:x}, report_id=0x{:x}, report_len={})",
-            sayomirror::logging::AsciiToWide(opened.openedPath),
-            opened.interfaceNumber,
-            static_cast<unsigned>(opened.usagePage),
-            static_cast<unsigned>(opened.usage),
-            static_cast<unsigned>(appState->proto.reportId22),
-            static_cast<unsigned>(appState->proto.reportLen22)));
-
-        std::wstring buf(256, L'\0');
-        if (hid_get_manufacturer_string(appState->dev.get(), buf.data(), buf.size()) == 0) {
-            sayomirror::logging::LogLine(std::format(L"Manufacturer String: {}", std::wstring_view(buf.c_str())));
-        }
-        buf.assign(256, L'\0');
-        if (hid_get_product_string(appState->dev.get(), buf.data(), buf.size()) == 0) {
-            sayomirror::logging::LogLine(std::format(L"Product String: {}", std::wstring_view(buf.c_str())));
+        // Open the device and read its geometry off the UI thread; the window shows
+        // progress meanwhile and WM_APP_SAYODEVICE_BRINGUP picks up the result.
+        sayo::BringUpOptions options{};
+        options.proto = appState->proto;
+        options.cache = &appState->infoCache;
+        appState->bringUpBackend = std::make_unique<sayo::HidapiBringUpBackend>(appState->ids);
+        appState->bringUp = std::make_unique<sayo::DeviceBringUp>(
+            *appState->bringUpBackend, options, [hWnd](const sayo::BringUpEvent& event) {
+                PostMessageW(hWnd, sayomirror::WM_APP_SAYODEVICE_BRINGUP, static_cast<WPARAM>(event.stage),
+                             static_cast<LPARAM>(event.error));
+            });
+        SetStatusText(appState, BringUpStatusText(sayo::BringUpStage::Enumerating, sayo::BringUpError::None));
+        appState->bringUp->Start();
+        return 0;
+    }
+    case sayomirror::WM_APP_SAYODEVICE_BRINGUP: {
+        if (!appState || !appState->bringUp) {
+            return 0;
         }
-#if _DEBUG
-        buf.assign(256, L'\0');
-        if (hid_get_serial_number_string(appState->dev.get(), buf.data(), buf.size()) == 0) {
-            sayomirror::logging::LogLine(std::format(L"Serial Number String: {}", std::wstring_view(buf.c_str())));
+        const auto stage = static_cast<sayo::BringUpStage>(wParam);
+        const auto error = static_cast<sayo::BringUpError>(lParam);
+        if (stage != sayo::BringUpStage::Ready) {
+            SetStatusText(appState, BringUpStatusText(stage, error));
+            if (stage == sayo::BringUpStage::Failed) {
+                sayomirror::logging::LogLine(BringUpStatusText(stage, error));
+            }
+            InvalidateRect(hWnd, nullptr, TRUE);
+            return 0;
         }
-#endif
 
-        const std::optional<std::pair<uint16_t, uint16_t>> lcd = sayo::TryGetLcdSize(appState->dev.get(), appState->proto);
-        if (!lcd) {
-            sayomirror::logging::LogLine(L"Opened device, but LCD size query timed out.");
-            break;
+        std::optional<sayo::BringUpResult> result = appState->bringUp->TakeResult();
+        if (!result) {
+            return 0;
         }
-        appState->srcW = lcd->first;
-        appState->srcH = lcd->second;
-        if (appState->srcW == 0 || appState->srcH == 0) {
-            sayomirror::logging::LogLine(L"Device reported invalid LCD size.");
-            break;
+        const sayo::BringUpTimings& t = result->timings;
+        sayomirror::logging::LogLine(std::format(
+            L"bring-up: {} us (cached path {} us, enumerate {} us, open {} us, SystemInfo {} us{})",
+            t.totalUs, t.openHintUs, t.enumerateUs, t.openUs, t.queryInfoUs,
+            result->infoFromCache ? L", cached" : L""));
+        sayomirror::logging::LogLine(std::format(
+            L"Opened path: {} (usage_page=0x{:x}, report_id=0x{:x}, report_len={}, codec={}, key={})",
+            sayomirror::logging::AsciiToWide(result->device.path),
+            static_cast<unsigned>(result->device.usagePage),
+            static_cast<unsigned>(result->proto.reportId22),
+            static_cast<unsigned>(result->proto.reportLen22),
+            sayomirror::logging::AsciiToWide(sayo::ReportVariantName(sayo::SelectReportVariant(result->proto))),
+            sayomirror::logging::AsciiToWide(result->device.key)));
+        if (result->info.refreshRate) {
+            sayomirror::logging::LogLine(std::format(L"LCD refresh rate reported by device: {} Hz",
+                                                     static_cast<unsigned>(*result->info.refreshRate)));
         }
+        sayomirror::logging::LogLine(std::format(L"LCD size reported by device: {}x{}", result->info.lcdW,
+                                                 result->info.lcdH));
 
-        sayomirror::logging::LogLine(std::format(L"LCD size reported by device: {}x{}", appState->srcW,
-                                                 appState->srcH));
+        appState->proto = result->proto;
+        appState->srcW = result->info.lcdW;
+        appState->srcH = result->info.lcdH;
+        appState->statusText.clear();
 
         sayomirror::window_utils::FitWindowToDevice(hWnd, appState->srcW, appState->srcH,
                                                     sayomirror::window_utils::FitMode::BestIntegerScale);
@@ -221,29 +249,36 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                                                      appState->presentTargetPeriodMs));
         }
 
-        appState->scratchIn.assign(appState->proto.reportLen22, 0);
-        appState->latestRgb565.assign(static_cast<size_t>(appState->srcW) * static_cast<size_t>(appState->srcH) * 2, 0);
-
-        sayomirror::capture::StartCaptureThread(appState, hWnd);
+        appState->reconnector = std::make_unique<sayo::Reconnector>(*appState->bringUpBackend);
+        sayomirror::capture::CreateSession(appState, hWnd, std::move(*result));
+        sayomirror::capture::StartCapture(appState);
         SetTimer(hWnd, kPresentTimerId, sayomirror::window_utils::ComputeNextPresentDelayMs(appState), nullptr);
+        InvalidateRect(hWnd, nullptr, TRUE);
         return 0;
     }
+    case sayomirror::WM_APP_SAYODEVICE_RECONNECTED:
+        if (appState) {
+            // WM_TIMER stopped presenting while the device was gone
+            KillTimer(hWnd, kPresentTimerId);
+            SetTimer(hWnd, kPresentTimerId, sayomirror::window_utils::ComputeNextPresentDelayMs(appState), nullptr);
+            InvalidateRect(hWnd, nullptr, TRUE);
+        }
+        return 0;
     case WM_TIMER:
         if (wParam == kPresentTimerId) {
             // prevent flicker
             if (appState) {
-                bool haveDevice = false;
-                {
-                    std::lock_guard lock(appState->stateMutex);
-                    haveDevice = (appState->dev != nullptr);
-                }
-                if (!haveDevice) {
+                if (!sayomirror::capture::IsCapturing(appState)) {
                     KillTimer(hWnd, kPresentTimerId);
                     return 0;
                 }
             }
 
-            InvalidateRect(hWnd, nullptr, FALSE);
+            // nothing to present until the session publishes past what was drawn
+            if (!appState || appState->session->Frames().PublishedSequence() !=
+                                 appState->session->Frames().FrontSequence()) {
+                InvalidateRect(hWnd, nullptr, FALSE);
+            }
 
             if (appState && appState->presentTargetPeriodMs > 0.0) {
                 KillTimer(hWnd, kPresentTimerId);
@@ -252,6 +287,16 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             return 0;
         }
         break;
+    case WM_SIZE:
+        // nothing is drawn while minimized, so stop asking the device for frames
+        if (appState && appState->session) {
+            if (wParam == SIZE_MINIMIZED) {
+                appState->session->Pause();
+            } else if (wParam == SIZE_RESTORED || wParam == SIZE_MAXIMIZED) {
+                appState->session->Resume();
+            }
+        }
+        return DefWindowProc(hWnd, message, wParam, lParam);
     case WM_SIZING: {
         if (!appState || appState->srcW == 0 || appState->srcH == 0) {
             break;
@@ -358,27 +403,33 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     case sayomirror::WM_APP_SAYODEVICE_DISCONNECTED:
         if (appState) {
             KillTimer(hWnd, kPresentTimerId);
-            sayomirror::capture::StopCaptureThread(appState);
+            sayomirror::capture::StopCapture(appState);
 
-            {
-                std::lock_guard lock(appState->stateMutex);
-                appState->dev.reset();
-                appState->statusText =
-                    L"SayoDevice disconnected/no longer found. Reconnect the device and reopen the program.";
-            }
+            appState->statusText =
+                L"SayoDevice disconnected/no longer found. Reconnect the device and reopen the program.";
 
             InvalidateRect(hWnd, nullptr, TRUE);
         }
         return 0;
+    case sayomirror::WM_APP_SAYODEVICE_INFO_CHANGED:
+        if (appState) {
+            // the session thread has already left its loop
+            sayomirror::capture::StopCapture(appState);
+
+            // Start() resizes the frames for the new geometry
+            appState->srcW = appState->session->Info().lcdW;
+            appState->srcH = appState->session->Info().lcdH;
+            sayomirror::window_utils::FitWindowToDevice(hWnd, appState->srcW, appState->srcH,
+                                                        sayomirror::window_utils::FitMode::BestIntegerScale);
+            sayomirror::capture::StartCapture(appState);
+        }
+        return 0;
     case WM_ERASEBKGND:
         // When the device is open, WM_PAINT blits the full client area so we
         // suppress background erases to reduce flicker. In error/not-opened
         // states, let DefWindowProc erase to the class background brush.
-        if (appState) {
-            std::lock_guard lock(appState->stateMutex);
-            if (appState->dev) {
-                return 1;
-            }
+        if (sayomirror::capture::IsCapturing(appState)) {
+            return 1;
         }
         return DefWindowProc(hWnd, message, wParam, lParam);
     case WM_LBUTTONDBLCLK:
@@ -403,16 +454,26 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         }
 
         std::wstring statusText;
-        
-        {
-            std::lock_guard lock(appState->stateMutex);
-            if (!appState->dev) {
-                if (appState->statusText.empty()) {
-                    const auto logName = sayomirror::logging::BuildDailyLogPath().filename().wstring();
-                    appState->statusText = L"Device not opened. Check " + logName;
-                }
-                statusText = appState->statusText;
+
+        const sayo::SessionState sessionState =
+            appState->session ? appState->session->State() : sayo::SessionState::Stopped;
+        switch (sessionState) {
+        case sayo::SessionState::Running:
+        case sayo::SessionState::Paused:
+        // the last frame stays up until WM_APP_SAYODEVICE_INFO_CHANGED restarts the session
+        case sayo::SessionState::GeometryChanged:
+            break;
+        case sayo::SessionState::Reconnecting:
+            statusText = L"SayoDevice disconnected, waiting for it to come back...";
+            break;
+        case sayo::SessionState::Stopped:
+        case sayo::SessionState::Lost:
+            if (appState->statusText.empty()) {
+                const auto logName = sayomirror::logging::BuildDailyLogPath().filename().wstring();
+                appState->statusText = L"Device not opened. Check " + logName;
             }
+            statusText = appState->statusText;
+            break;
         }
 
         if (!statusText.empty()) {
@@ -509,19 +570,20 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         const int dstW = clientW;
         const int dstH = clientH;
 
-        {
-            std::lock_guard lock(appState->latestMutex);
-            if (!appState->latestRgb565.empty()) {
-                sayo::BlitRgb565ToHdc(
-                    hdc,
-                    appState->latestRgb565,
-                    appState->srcW,
-                    appState->srcH,
-                    dstX,
-                    dstY,
-                    dstW,
-                    dstH);
-            }
+        // the session thread never waits on this; without a new frame the last one is drawn again
+        sayo::FrameExchange& frames = appState->session->Frames();
+        (void)frames.Acquire();
+        const sayo::Frame& frame = frames.Front();
+        if (!frame.Empty()) {
+            sayo::BlitRgb565ToHdc(
+                hdc,
+                frame.Pixels(),
+                frame.Meta().width,
+                frame.Meta().height,
+                dstX,
+                dstY,
+                dstW,
+                dstH);
         }
 
         EndPaint(hWnd, &ps);
@@ -534,10 +596,14 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     case WM_NCDESTROY: {
         appState = reinterpret_cast<sayomirror::AppState*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
         KillTimer(hWnd, kPresentTimerId);
-        sayomirror::capture::StopCaptureThread(appState);
         if (appState) {
-            std::lock_guard lock(appState->stateMutex);
-            appState->dev.reset();
+            // cancels and waits for a bring-up that is still running
+            appState->bringUp.reset();
+        }
+        sayomirror::capture::StopCapture(appState);
+        if (appState) {
+            // closes the device before hidapi goes away
+            appState->session.reset();
         }
         hid_exit();
         SetWindowLongPtrW(hWnd, GWLP_USERDATA, 0);
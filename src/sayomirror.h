@@ -1,46 +1,50 @@
 #pragma once
 
-#include <atomic>
 #include <cstdint>
 #include <memory>
-#include <mutex>
 #include <string>
-#include <thread>
-#include <vector>
 
 #include "Resource.h"
 
+#include "sayo_bringup.h"
+#include "sayo_capture_session.h"
+#include "sayo_codec.h"
+#include "sayo_hidapi_bringup.h"
+#include "sayo_info_cache.h"
+#include "sayo_reconnect.h"
 #include "sayo_screen_capture.h"
-
-struct hid_device;
+#include "sayo_transport.h"
 
 namespace sayomirror {
-    struct HidDeviceDeleter {
-        void operator()(hid_device* d) const noexcept;
-    };
-
     struct AppState {
         sayo::DeviceIds ids{};
         sayo::ProtocolConstants proto{};
-        std::unique_ptr<hid_device, HidDeviceDeleter> dev;
 
+        // UI thread only
         std::wstring statusText;
 
-        std::mutex stateMutex;
-
+        // LCD size the window is fitted to; copied from session->Info() while it is stopped
         uint16_t srcW = 0;
         uint16_t srcH = 0;
 
-        std::vector<uint8_t> scratchIn;
-        std::vector<uint8_t> latestRgb565;
-        std::mutex latestMutex;
+        // SystemInfo remembered from earlier runs; the session re-queries the device
+        // when the bring-up answer came from here.
+        sayo::DeviceInfoCache infoCache;
+
+        // after infoCache, which the bring-up thread writes to
+        std::unique_ptr<sayo::HidapiBringUpBackend> bringUpBackend;
+        std::unique_ptr<sayo::DeviceBringUp> bringUp;
+        // used by the session after a DeviceError; shares bringUpBackend
+        std::unique_ptr<sayo::Reconnector> reconnector;
+
+        // Owns the device once bring-up is done and captures on its own thread. The UI
+        // reads State() and Frames(); everything else comes through the sinks that
+        // sayomirror::capture installs. After reconnector, which it uses.
+        std::unique_ptr<sayo::CaptureSession> session;
 
         // Present scheduling: SetTimer only takes integer milliseconds, so we
         // store a fractional target period and optionally dither the interval.
         double presentTargetPeriodMs = 0.0;
         double presentFracAccumulatorMs = 0.0;
-
-        std::atomic<bool> stop{false};
-        std::thread captureThread;
     };
 }
@@ -1,133 +1,129 @@
 #include "sayomirror_capture.h"
 #include "sayomirror.h"
 #include "sayomirror_logging.h"
+#include "sayo_capture_session.h"
+#include "sayo_reconnect.h"
 
 #include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <format>
-#include <thread>
-#include <vector>
+#include <memory>
+#include <utility>
 
-void sayomirror::capture::StopCaptureThread(sayomirror::AppState* appState) {
-    if (!appState) {
-        return;
-    }
-    appState->stop.store(true, std::memory_order_relaxed);
-    if (appState->captureThread.joinable()) {
-        appState->captureThread.join();
-    }
-}
-
-void sayomirror::capture::StartCaptureThread(sayomirror::AppState* appState, const HWND hwnd) {
-    if (!appState) {
-        return;
-    }
-    appState->stop.store(false, std::memory_order_relaxed);
-    appState->captureThread = std::thread([appState, hwnd] {
+namespace {
+    // Called on the session thread: wake the UI and log about once a second.
+    sayo::CaptureSession::FrameSink MakeFrameSink(sayomirror::AppState* appState, const HWND hwnd) {
         using Clock = std::chrono::steady_clock;
-
-        auto lastLog = Clock::now();
-        auto windowStart = lastLog;
-        uint32_t framesInWindow = 0;
-        uint32_t lastFrameMs = 0;
-        sayo::CaptureStats lastStats{};
-
-        std::vector<uint8_t> frame;
-
-        while (!appState->stop.load(std::memory_order_relaxed)) {
-            bool isReady = false;
-            {
-                std::lock_guard<std::mutex> lock(appState->stateMutex);
-                isReady = (appState->dev != nullptr) && (appState->srcW != 0) && (appState->srcH != 0);
+        return [appState, hwnd, lastLog = Clock::now(), framesInWindow = uint32_t{0}](
+                   const sayo::Frame& frame, const sayo::SessionFrameInfo& info) mutable {
+            InvalidateRect(hwnd, nullptr, FALSE);
+            framesInWindow++;
+            if (info.firstAfterReconnect) {
+                sayomirror::logging::LogLine(std::format(L"first frame {} ms after the device dropped",
+                                                         appState->reconnector->Stats().lastTimeToFirstFrameMs));
             }
 
-            if (!isReady) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                continue;
+            const auto now = Clock::now();
+            if (now - lastLog < std::chrono::seconds(1)) {
+                return;
             }
-
-            // should be exactly 25600 bytes on 160x80 displays!!!
-            const size_t expectedFrameBytes =
-                static_cast<size_t>(appState->srcW) * static_cast<size_t>(appState->srcH) * static_cast<size_t>(2);
-            if (frame.capacity() < expectedFrameBytes) {
-                frame.reserve(expectedFrameBytes);
+            const double secs = std::chrono::duration<double>(now - lastLog).count();
+            int fps = 0;
+            if (secs > 0.0) {
+                fps = static_cast<int>(std::lround(static_cast<double>(framesInWindow) / secs));
             }
-            frame.clear();
-
-            sayo::CaptureStats stats{};
-            const auto t0 = Clock::now();
-
-            sayo::CaptureFrameResult captureResult = sayo::CaptureFrameResult::NoData;
-            bool shouldNotifyDisconnect = false;
-            {
-                std::lock_guard<std::mutex> lock(appState->stateMutex);
-                if (!appState->dev) {
-                    captureResult = sayo::CaptureFrameResult::NoData;
-                }
-                else {
-                    captureResult = sayo::CaptureScreenFrame(
-                        appState->dev.get(),
-                        appState->srcW,
-                        appState->srcH,
-                        appState->scratchIn, // reference
-                        frame, // reference
-                        &stats,
-                        appState->proto);
+            const sayo::FrameMeta& meta = frame.Meta();
+            const auto firstChunkMs =
+                std::chrono::duration_cast<std::chrono::milliseconds>(meta.firstChunkAt - meta.startedAt).count();
+
+            sayomirror::logging::LogLine(std::format(
+                L"screen cap stats: {} fps, last={}ms (first chunk {}ms), packets={}, bytes={}/{}",
+                fps,
+                meta.stats.durationMs,
+                firstChunkMs,
+                meta.stats.packets,
+                meta.stats.bytesCovered,
+                frame.Pixels().size()));
+
+            lastLog = now;
+            framesInWindow = 0;
+        };
+    }
 
-                    if (captureResult == sayo::CaptureFrameResult::DeviceError) {
-                        shouldNotifyDisconnect = true;
-                        appState->stop.store(true, std::memory_order_relaxed);
-                    }
+    // Called on the session thread, which can't stop itself: anything that needs a
+    // restart or teardown is posted to the window.
+    sayo::CaptureSession::StateSink MakeStateSink(sayomirror::AppState* appState, const HWND hwnd) {
+        return [appState, hwnd, previous = sayo::SessionState::Stopped](const sayo::SessionState state) mutable {
+            switch (state) {
+            case sayo::SessionState::Reconnecting:
+                sayomirror::logging::LogLine(L"Device lost, reconnecting.");
+                InvalidateRect(hwnd, nullptr, TRUE);
+                break;
+            case sayo::SessionState::Running:
+                if (previous == sayo::SessionState::Reconnecting) {
+                    const sayo::ReconnectStats stats = appState->reconnector->Stats();
+                    sayomirror::logging::LogLine(std::format(
+                        L"Reconnected after {} ms ({} attempts so far): {}",
+                        stats.lastReopenMs, stats.attempts,
+                        sayomirror::logging::AsciiToWide(appState->session->Device().path)));
+                    PostMessageW(hwnd, sayomirror::WM_APP_SAYODEVICE_RECONNECTED, 0, 0);
                 }
+                break;
+            case sayo::SessionState::Lost:
+                PostMessageW(hwnd, sayomirror::WM_APP_SAYODEVICE_DISCONNECTED, 0, 0);
+                break;
+            case sayo::SessionState::GeometryChanged: {
+                const sayo::SystemInfo& info = appState->session->Info();
+                sayomirror::logging::LogLine(std::format(L"LCD size changed since it was cached: {}x{} -> {}x{}",
+                                                         appState->srcW, appState->srcH, info.lcdW, info.lcdH));
+                PostMessageW(hwnd, sayomirror::WM_APP_SAYODEVICE_INFO_CHANGED, 0, 0);
+                break;
             }
-
-            const auto t1 = Clock::now();
-            lastFrameMs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count());
-
-            if (captureResult == sayo::CaptureFrameResult::DeviceError) {
-                if (shouldNotifyDisconnect) {
-                    PostMessageW(hwnd, sayomirror::WM_APP_SAYODEVICE_DISCONNECTED, 0, 0);
-                }
+            case sayo::SessionState::Stopped:
+            case sayo::SessionState::Paused:
                 break;
             }
+            previous = state;
+        };
+    }
+}
 
-            if (captureResult == sayo::CaptureFrameResult::Ok) {
-                framesInWindow++;
-                lastStats = stats;
-
-                {
-                    std::lock_guard<std::mutex> lock(appState->latestMutex);
-                    appState->latestRgb565.swap(frame);
-                }
-                InvalidateRect(hwnd, nullptr, FALSE);
+void sayomirror::capture::CreateSession(sayomirror::AppState* appState, const HWND hwnd, sayo::BringUpResult&& result) {
+    if (!appState) {
+        return;
+    }
+    sayo::CaptureSessionConfig config{};
+    config.proto = result.proto;
+    config.reconnector = appState->reconnector.get();
+    config.cache = &appState->infoCache;
+    // use last run's answer now, the session checks it against the device
+    config.revalidateInfo = result.infoFromCache;
+
+    appState->session = std::make_unique<sayo::CaptureSession>(std::move(result.device), result.info, config);
+    appState->session->AddFrameSink(MakeFrameSink(appState, hwnd));
+    appState->session->SetStateSink(MakeStateSink(appState, hwnd));
+}
 
-                const auto now = Clock::now();
-                if (now - lastLog >= std::chrono::seconds(1)) {
-                    const double secs = std::chrono::duration<double>(now - windowStart).count();
-                    int fps = 0;
-                    if (secs > 0.0) {
-                        fps = static_cast<int>(std::lround(static_cast<double>(framesInWindow) / secs));
-                    }
-                    const unsigned long long expectedBytes =
-                        static_cast<size_t>(appState->srcW) * static_cast<size_t>(appState->srcH) * 2ull;
+void sayomirror::capture::StopCapture(sayomirror::AppState* appState) {
+    if (!appState || !appState->session) {
+        return;
+    }
+    appState->session->Stop();
+}
 
-                    sayomirror::logging::LogLine(std::format(
-                        L"screen cap stats: {} fps, last={}ms, packets={}, bytes={}/{}",
-                        fps,
-                        lastFrameMs,
-                        lastStats.packets,
-                        lastStats.bytesCovered,
-                        expectedBytes));
+void sayomirror::capture::StartCapture(sayomirror::AppState* appState) {
+    if (!appState || !appState->session) {
+        return;
+    }
+    (void)appState->session->Start();
+}
 
-                    lastLog = now;
-                    windowStart = now;
-                    framesInWindow = 0;
-                }
-            }
-            else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(5));
-            }
-        }
-    });
+bool sayomirror::capture::IsCapturing(const sayomirror::AppState* appState) {
+    if (!appState || !appState->session) {
+        return false;
+    }
+    const sayo::SessionState state = appState->session->State();
+    return state == sayo::SessionState::Running || state == sayo::SessionState::Paused ||
+           state == sayo::SessionState::GeometryChanged;
 }
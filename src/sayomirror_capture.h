@@ -2,13 +2,27 @@
 
 #include "framework.h"
 
+#include "sayo_bringup.h"
+
 namespace sayomirror {
     struct AppState;
     
     constexpr UINT WM_APP_SAYODEVICE_DISCONNECTED = WM_APP + 1;
+    // the device's SystemInfo no longer matches the cached one; the session thread has exited
+    constexpr UINT WM_APP_SAYODEVICE_INFO_CHANGED = WM_APP + 2;
+    // wParam: sayo::BringUpStage, lParam: sayo::BringUpError
+    constexpr UINT WM_APP_SAYODEVICE_BRINGUP = WM_APP + 3;
+    // the session got the device back after a drop
+    constexpr UINT WM_APP_SAYODEVICE_RECONNECTED = WM_APP + 4;
 }
 
 namespace sayomirror::capture {
-    void StartCaptureThread(sayomirror::AppState* appState, HWND hwnd);
-    void StopCaptureThread(sayomirror::AppState* appState);
+    // Builds appState->session around the bring-up result, reporting to hwnd: frames
+    // invalidate it, and drops, reconnects and size changes are posted to it.
+    void CreateSession(sayomirror::AppState* appState, HWND hwnd, sayo::BringUpResult&& result);
+    void StartCapture(sayomirror::AppState* appState);
+    void StopCapture(sayomirror::AppState* appState);
+    // A device is open and WM_PAINT draws frames: running, paused, or waiting for the
+    // restart after a geometry change.
+    bool IsCapturing(const sayomirror::AppState* appState);
 }
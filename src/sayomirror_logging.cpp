@@ -43,18 +43,6 @@ namespace {
         return out;
     }
 
-    std::filesystem::path GetExeDirectory() {
-        std::wstring modulePath;
-        modulePath.resize(MAX_PATH);
-        const DWORD modulePathLen = GetModuleFileNameW(nullptr, modulePath.data(), static_cast<DWORD>(modulePath.size()));
-        if (modulePathLen == 0) {
-            return std::filesystem::current_path();
-        }
-        modulePath.resize(modulePathLen);
-        std::filesystem::path exePath(modulePath);
-        return exePath.has_parent_path() ? exePath.parent_path() : std::filesystem::current_path();
-    }
-
     std::string BuildTimestampPrefix() {
         const auto now = std::chrono::system_clock::now();
         const auto nowMs = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
@@ -79,6 +67,18 @@ std::wstring sayomirror::logging::AsciiToWide(const std::string_view str) {
     return out;
 }
 
+std::filesystem::path sayomirror::logging::GetExeDirectory() {
+    std::wstring modulePath;
+    modulePath.resize(MAX_PATH);
+    const DWORD modulePathLen = GetModuleFileNameW(nullptr, modulePath.data(), static_cast<DWORD>(modulePath.size()));
+    if (modulePathLen == 0) {
+        return std::filesystem::current_path();
+    }
+    modulePath.resize(modulePathLen);
+    std::filesystem::path exePath(modulePath);
+    return exePath.has_parent_path() ? exePath.parent_path() : std::filesystem::current_path();
+}
+
 std::filesystem::path sayomirror::logging::BuildDailyLogPath() {
     const auto now = std::chrono::system_clock::now();
     const std::time_t nowTime = std::chrono::system_clock::to_time_t(now);
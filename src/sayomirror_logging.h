@@ -6,6 +6,7 @@
 
 namespace sayomirror::logging {
     std::wstring AsciiToWide(std::string_view str);
+    std::filesystem::path GetExeDirectory();
     std::filesystem::path BuildDailyLogPath();
     void LogLine(std::wstring_view message);
 }